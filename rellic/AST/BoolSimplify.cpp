@@ -0,0 +1,519 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <glog/logging.h>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/FoldingSet.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "rellic/AST/BoolSimplify.h"
+#include "rellic/AST/Util.h"
+
+namespace rellic {
+
+namespace {
+
+// Truth tables are used for up to this many atoms
+static const unsigned kMaxTruthTableVars = 6;
+// Conditions with more atoms are left to Z3
+static const unsigned kMaxBDDVars = 64;
+// Conditions whose BDDs need more nodes are left to Z3
+static const unsigned kMaxBDDNodes = 1U << 20;
+
+// Truth tables of the variables of 6-input functions
+static const uint64_t kVarMasks[kMaxTruthTableVars] = {
+    0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL};
+
+struct Atom {
+  // Whether the atom is a comparison with a complementary comparison, e.g.
+  // `<` and `>=`. Those are stored as `<`, `>` or `==`.
+  bool invertible;
+  clang::BinaryOperatorKind opc;
+  // Occurrences of the atom and of its complement, if any
+  clang::Expr *pos;
+  clang::Expr *neg;
+};
+
+// Occurrence of an atom, or of its complement if `negated` is set
+struct Literal {
+  unsigned atom;
+  bool negated;
+};
+
+// A conjunction of literals
+using Cube = std::vector<Literal>;
+
+// Abstracts the atoms of a condition to variables
+class AtomTable {
+ private:
+  clang::ASTContext &ctx;
+  std::vector<llvm::FoldingSetNodeID> keys;
+  std::unordered_map<unsigned, std::vector<unsigned>> ids;
+  // Atom that first referred to a declaration
+  llvm::DenseMap<clang::ValueDecl *, unsigned> decl_atoms;
+
+  void AddDecls(clang::Stmt *stmt, unsigned atom) {
+    std::vector<clang::Stmt *> work{stmt};
+    while (!work.empty() && !interacting) {
+      auto node = work.back();
+      work.pop_back();
+      if (auto ref = clang::dyn_cast<clang::DeclRefExpr>(node)) {
+        auto iter = decl_atoms.insert({ref->getDecl(), atom}).first;
+        interacting |= iter->second != atom;
+      }
+      for (auto child : node->children()) {
+        if (child) {
+          work.push_back(child);
+        }
+      }
+    }
+  }
+
+  void AddAtom(clang::Expr *expr) {
+    llvm::FoldingSetNodeID key;
+    Atom atom = {false, clang::BO_Comma, expr, nullptr};
+    bool negated = false;
+    auto cmp = clang::dyn_cast<clang::BinaryOperator>(expr);
+    if (cmp && cmp->isComparisonOp() &&
+        !cmp->getLHS()->getType()->isRealFloatingType()) {
+      atom.invertible = true;
+      atom.opc = cmp->getOpcode();
+      if (atom.opc == clang::BO_GE || atom.opc == clang::BO_LE ||
+          atom.opc == clang::BO_NE) {
+        atom.opc = clang::BinaryOperator::negateComparisonOp(atom.opc);
+        std::swap(atom.pos, atom.neg);
+        negated = true;
+      }
+      key.AddBoolean(true);
+      key.AddInteger(atom.opc);
+      cmp->getLHS()->Profile(key, ctx, /*Canonical=*/true);
+      cmp->getRHS()->Profile(key, ctx, /*Canonical=*/true);
+    } else {
+      key.AddBoolean(false);
+      expr->Profile(key, ctx, /*Canonical=*/true);
+    }
+
+    auto &bucket = ids[key.ComputeHash()];
+    for (auto id : bucket) {
+      if (keys[id] == key) {
+        auto &known = atoms[id];
+        auto &occurrence = negated ? known.neg : known.pos;
+        occurrence = occurrence ? occurrence : expr;
+        literals[expr] = {id, negated};
+        return;
+      }
+    }
+
+    unsigned id = atoms.size();
+    bucket.push_back(id);
+    keys.push_back(key);
+    atoms.push_back(atom);
+    literals[expr] = {id, negated};
+    AddDecls(expr, id);
+  }
+
+ public:
+  std::vector<Atom> atoms;
+  llvm::DenseMap<clang::Expr *, Literal> literals;
+  // Number of occurrences of atoms
+  unsigned num_literals;
+  // Set if two atoms refer to the same declaration
+  bool interacting;
+
+  AtomTable(clang::ASTContext &ctx)
+      : ctx(ctx), num_literals(0), interacting(false) {}
+
+  // Abstracts the atoms of `expr` in pre-order, without recursion, since
+  // conditions of long if-ladders are deeply nested. Stops and returns
+  // false as soon as `expr` can not be simplified without Z3, because its
+  // atoms interact or are too many.
+  bool Collect(clang::Expr *expr) {
+    std::vector<clang::Expr *> work{expr};
+    while (!work.empty()) {
+      auto node = work.back()->IgnoreParens();
+      work.pop_back();
+      if (auto unop = clang::dyn_cast<clang::UnaryOperator>(node)) {
+        if (unop->getOpcode() == clang::UO_LNot) {
+          work.push_back(unop->getSubExpr());
+          continue;
+        }
+      } else if (auto binop = clang::dyn_cast<clang::BinaryOperator>(node)) {
+        if (binop->getOpcode() == clang::BO_LAnd ||
+            binop->getOpcode() == clang::BO_LOr) {
+          work.push_back(binop->getRHS());
+          work.push_back(binop->getLHS());
+          continue;
+        }
+      } else if (clang::isa<clang::IntegerLiteral>(node)) {
+        continue;
+      }
+
+      if (!literals.count(node)) {
+        AddAtom(node);
+      }
+      ++num_literals;
+      if (interacting || atoms.size() > kMaxBDDVars) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Boolean functions of up to 6 variables as 64-bit truth tables
+class TruthTables {
+ private:
+  unsigned num_vars;
+  uint64_t mask;
+
+ public:
+  using Func = uint64_t;
+
+  TruthTables(unsigned num_vars)
+      : num_vars(num_vars),
+        mask(num_vars == kMaxTruthTableVars ? ~0ULL
+                                            : (1ULL << (1U << num_vars)) - 1) {}
+
+  Func Zero() { return 0; }
+  Func One() { return mask; }
+  Func Var(unsigned var) { return kVarMasks[var] & mask; }
+  Func Not(Func f) { return ~f & mask; }
+  Func And(Func f, Func g) { return f & g; }
+  Func Or(Func f, Func g) { return f | g; }
+
+  Func Cofactor(Func f, unsigned var, bool value) {
+    auto shift = 1U << var;
+    if (value) {
+      auto hi = f & kVarMasks[var];
+      return hi | (hi >> shift);
+    }
+    auto lo = f & ~kVarMasks[var];
+    return (lo | (lo << shift)) & mask;
+  }
+
+  // Lowest variable `f` depends on
+  unsigned TopVar(Func f) {
+    for (auto var = 0U; var < num_vars; ++var) {
+      if (Cofactor(f, var, false) != Cofactor(f, var, true)) {
+        return var;
+      }
+    }
+    return num_vars;
+  }
+};
+
+// Boolean functions as reduced ordered BDDs
+class BDDs {
+ private:
+  static const unsigned kTerminal = ~0U;
+
+  struct Node {
+    unsigned var;
+    unsigned lo;
+    unsigned hi;
+  };
+
+  std::vector<Node> nodes;
+  std::unordered_map<uint64_t, unsigned> unique;
+  std::unordered_map<uint64_t, unsigned> ite_cache;
+
+  // Node indices stay below `kMaxBDDNodes`, so 20 bits each suffice.
+  static uint64_t Key(uint64_t a, uint64_t b, uint64_t c) {
+    return (a << 40) | (b << 20) | c;
+  }
+
+  unsigned MakeNode(unsigned var, unsigned lo, unsigned hi) {
+    if (lo == hi) {
+      return lo;
+    }
+    auto key = Key(var, lo, hi);
+    auto iter = unique.find(key);
+    if (iter != unique.end()) {
+      return iter->second;
+    }
+    if (nodes.size() >= kMaxBDDNodes) {
+      overflow = true;
+      return 0;
+    }
+    nodes.push_back({var, lo, hi});
+    unique[key] = nodes.size() - 1;
+    return nodes.size() - 1;
+  }
+
+  unsigned Ite(unsigned f, unsigned g, unsigned h) {
+    if (f == 1) {
+      return g;
+    } else if (f == 0 || g == h) {
+      return h;
+    } else if (g == 1 && h == 0) {
+      return f;
+    }
+    auto key = Key(f, g, h);
+    auto iter = ite_cache.find(key);
+    if (iter != ite_cache.end()) {
+      return iter->second;
+    }
+    auto var = std::min({TopVar(f), TopVar(g), TopVar(h)});
+    auto lo = Ite(Cofactor(f, var, false), Cofactor(g, var, false),
+                  Cofactor(h, var, false));
+    auto hi = Ite(Cofactor(f, var, true), Cofactor(g, var, true),
+                  Cofactor(h, var, true));
+    auto result = MakeNode(var, lo, hi);
+    ite_cache[key] = result;
+    return result;
+  }
+
+ public:
+  using Func = unsigned;
+
+  // Set once the node limit is hit; results are invalid afterwards.
+  bool overflow;
+
+  BDDs() : overflow(false) {
+    nodes.push_back({kTerminal, 0, 0});
+    nodes.push_back({kTerminal, 1, 1});
+  }
+
+  Func Zero() { return 0; }
+  Func One() { return 1; }
+  Func Var(unsigned var) { return MakeNode(var, 0, 1); }
+  Func Not(Func f) { return Ite(f, 0, 1); }
+  Func And(Func f, Func g) { return Ite(f, g, 0); }
+  Func Or(Func f, Func g) { return Ite(f, 1, g); }
+
+  Func Cofactor(Func f, unsigned var, bool value) {
+    auto node = nodes[f];
+    if (node.var != var) {
+      return f;
+    }
+    return value ? node.hi : node.lo;
+  }
+
+  unsigned TopVar(Func f) { return nodes[f].var; }
+};
+
+// Irredundant sum-of-products cover of a function, computed with the
+// Minato-Morreale algorithm. Gives up once the cover has more than `budget`
+// literals.
+template <typename Algebra>
+class IsopCover {
+ private:
+  using Func = typename Algebra::Func;
+
+  Algebra &alg;
+  unsigned budget;
+  Cube prefix;
+
+  // Covers some function between `lower` and `upper` and returns it
+  Func Build(Func lower, Func upper) {
+    if (exceeded || lower == alg.Zero()) {
+      return alg.Zero();
+    }
+    if (upper == alg.One()) {
+      cubes.push_back(prefix);
+      num_literals += prefix.size();
+      exceeded = num_literals > budget;
+      return alg.One();
+    }
+    auto var = std::min(alg.TopVar(lower), alg.TopVar(upper));
+    auto l0 = alg.Cofactor(lower, var, false);
+    auto l1 = alg.Cofactor(lower, var, true);
+    auto u0 = alg.Cofactor(upper, var, false);
+    auto u1 = alg.Cofactor(upper, var, true);
+    // Cubes that need `!var`
+    prefix.push_back({var, true});
+    auto r0 = Build(alg.And(l0, alg.Not(u1)), u0);
+    // Cubes that need `var`
+    prefix.back().negated = false;
+    auto r1 = Build(alg.And(l1, alg.Not(u0)), u1);
+    prefix.pop_back();
+    // Cubes without `var`
+    auto rest = alg.Or(alg.And(l0, alg.Not(r0)), alg.And(l1, alg.Not(r1)));
+    auto rs = Build(rest, alg.And(u0, u1));
+    auto x = alg.Var(var);
+    return alg.Or(alg.Or(alg.And(alg.Not(x), r0), alg.And(x, r1)), rs);
+  }
+
+ public:
+  std::vector<Cube> cubes;
+  unsigned num_literals;
+  bool exceeded;
+
+  IsopCover(Algebra &alg, Func func, unsigned budget)
+      : alg(alg), budget(budget), num_literals(0), exceeded(false) {
+    Build(func, func);
+  }
+};
+
+// Evaluates `expr` in post-order over an explicit stack. Operators are
+// pushed again after their operands, which are evaluated left to right.
+template <typename Algebra>
+static typename Algebra::Func Eval(Algebra &alg, AtomTable &table,
+                                   clang::Expr *expr) {
+  using Func = typename Algebra::Func;
+  // Expressions and whether their operands have been evaluated
+  std::vector<std::pair<clang::Expr *, bool>> work{{expr, false}};
+  std::vector<Func> values;
+  while (!work.empty()) {
+    auto node = work.back().first->IgnoreParens();
+    auto evaluated = work.back().second;
+    work.pop_back();
+    auto unop = clang::dyn_cast<clang::UnaryOperator>(node);
+    auto binop = clang::dyn_cast<clang::BinaryOperator>(node);
+    if (unop && unop->getOpcode() == clang::UO_LNot) {
+      if (evaluated) {
+        values.back() = alg.Not(values.back());
+      } else {
+        work.push_back({node, true});
+        work.push_back({unop->getSubExpr(), false});
+      }
+      continue;
+    }
+    if (binop && (binop->getOpcode() == clang::BO_LAnd ||
+                  binop->getOpcode() == clang::BO_LOr)) {
+      if (evaluated) {
+        auto rhs = values.back();
+        values.pop_back();
+        auto lhs = values.back();
+        values.back() = binop->getOpcode() == clang::BO_LAnd
+                            ? alg.And(lhs, rhs)
+                            : alg.Or(lhs, rhs);
+      } else {
+        work.push_back({node, true});
+        work.push_back({binop->getRHS(), false});
+        work.push_back({binop->getLHS(), false});
+      }
+      continue;
+    }
+    if (auto lit = clang::dyn_cast<clang::IntegerLiteral>(node)) {
+      values.push_back(lit->getValue().getBoolValue() ? alg.One()
+                                                      : alg.Zero());
+      continue;
+    }
+    auto iter = table.literals.find(node);
+    CHECK(iter != table.literals.end()) << "Atom was not abstracted!";
+    auto var = alg.Var(iter->second.atom);
+    values.push_back(iter->second.negated ? alg.Not(var) : var);
+  }
+  return values.back();
+}
+
+class Emitter {
+ private:
+  clang::ASTContext &ctx;
+  AtomTable &table;
+
+  clang::Expr *EmitLiteral(const Literal &lit) {
+    auto &atom = table.atoms[lit.atom];
+    auto known = lit.negated ? atom.neg : atom.pos;
+    if (known) {
+      return known;
+    } else if (atom.invertible) {
+      auto cmp = clang::cast<clang::BinaryOperator>(atom.pos ? atom.pos
+                                                             : atom.neg);
+      auto opc = lit.negated
+                     ? clang::BinaryOperator::negateComparisonOp(atom.opc)
+                     : atom.opc;
+      return CreateBinaryOperator(ctx, opc, cmp->getLHS(), cmp->getRHS(),
+                                  cmp->getType());
+    }
+    return CreateNotExpr(ctx, atom.pos);
+  }
+
+ public:
+  Emitter(clang::ASTContext &ctx, AtomTable &table) : ctx(ctx), table(table) {}
+
+  clang::Expr *EmitSum(const std::vector<Cube> &cubes) {
+    clang::Expr *result = nullptr;
+    for (auto &cube : cubes) {
+      clang::Expr *product = nullptr;
+      for (auto &lit : cube) {
+        product = CreateAndExpr(ctx, product, EmitLiteral(lit));
+      }
+      result = CreateOrExpr(ctx, result, product);
+    }
+    return result;
+  }
+
+  // Emits the product of the complements of `cubes`
+  clang::Expr *EmitProduct(const std::vector<Cube> &cubes) {
+    clang::Expr *result = nullptr;
+    for (auto &cube : cubes) {
+      clang::Expr *sum = nullptr;
+      for (auto &lit : cube) {
+        sum = CreateOrExpr(ctx, sum, EmitLiteral({lit.atom, !lit.negated}));
+      }
+      result = CreateAndExpr(ctx, result, sum);
+    }
+    return result;
+  }
+};
+
+template <typename Algebra>
+static clang::Expr *Minimize(clang::ASTContext &ctx, Algebra &alg,
+                             AtomTable &table, clang::Expr *expr) {
+  auto func = Eval(alg, table, expr);
+  if (func == alg.Zero() || func == alg.One()) {
+    if (clang::isa<clang::IntegerLiteral>(expr->IgnoreParens())) {
+      return expr;
+    }
+    auto type = ctx.UnsignedIntTy;
+    llvm::APInt val(ctx.getIntWidth(type), func == alg.One() ? 1 : 0);
+    return CreateIntegerLiteral(ctx, val, type);
+  }
+
+  if (table.num_literals < 2) {
+    return expr;
+  }
+
+  // Only covers with fewer literals than `expr` are of interest
+  auto budget = table.num_literals - 1;
+  IsopCover<Algebra> sop(alg, func, budget);
+  IsopCover<Algebra> pos(alg, alg.Not(func), budget);
+  Emitter emitter(ctx, table);
+  if (!sop.exceeded && (pos.exceeded || sop.num_literals <= pos.num_literals)) {
+    return emitter.EmitSum(sop.cubes);
+  } else if (!pos.exceeded) {
+    return emitter.EmitProduct(pos.cubes);
+  }
+  return expr;
+}
+
+}  // namespace
+
+clang::Expr *BoolSimplifier::Simplify(clang::Expr *expr) {
+  AtomTable table(*ast_ctx);
+  if (!table.Collect(expr)) {
+    return nullptr;
+  }
+
+  if (table.atoms.size() <= kMaxTruthTableVars) {
+    TruthTables alg(table.atoms.size());
+    return Minimize(*ast_ctx, alg, table, expr);
+  }
+
+  BDDs alg;
+  auto result = Minimize(*ast_ctx, alg, table, expr);
+  return alg.overflow ? nullptr : result;
+}
+
+}  // namespace rellic
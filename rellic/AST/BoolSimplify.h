@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Expr.h>
+
+namespace rellic {
+
+// Simplifies conditions that are boolean combinations of independent atoms
+// without Z3. Atoms, i.e. comparisons and other non-boolean operands of
+// `!`, `&&` and `||`, are abstracted to variables. The resulting boolean
+// function is minimized using truth tables for up to 6 atoms and BDDs for
+// more, and emitted as a sum or a product of atoms, whichever is smaller.
+class BoolSimplifier {
+ private:
+  clang::ASTContext *ast_ctx;
+
+ public:
+  BoolSimplifier(clang::ASTContext &ctx) : ast_ctx(&ctx) {}
+
+  // Returns a minimal form of `expr`, which is `expr` itself if it can not
+  // be made smaller. Returns `nullptr` if atoms of `expr` refer to the same
+  // variables, so that they have to be simplified with their arithmetic
+  // semantics, or if `expr` is too large.
+  clang::Expr *Simplify(clang::Expr *expr);
+};
+
+}  // namespace rellic
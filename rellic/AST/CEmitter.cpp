@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <glog/logging.h>
+
+#include <llvm/ADT/SmallString.h>
+
+#include <clang/AST/Decl.h>
+
+#include "rellic/AST/CEmitter.h"
+#include "rellic/AST/Precedence.h"
+
+namespace rellic {
+
+namespace {
+
+// Output is written to the stream once the buffer reaches this size
+static constexpr size_t kFlushSize = 1 << 20;
+
+// Whether `expr` is printed with a leading sign, which must not be merged
+// with the sign of a unary operator
+static bool HasSign(clang::Expr *expr) {
+  expr = expr->IgnoreImpCasts();
+  if (auto lit = clang::dyn_cast<clang::IntegerLiteral>(expr)) {
+    return lit->getType()->isSignedIntegerType() &&
+           lit->getValue().isNegative();
+  }
+  if (auto lit = clang::dyn_cast<clang::FloatingLiteral>(expr)) {
+    return lit->getValue().isNegative();
+  }
+  return false;
+}
+
+static std::string GetIntegerString(const llvm::APInt &val,
+                                    clang::QualType type) {
+  llvm::SmallString<32> str;
+  val.toString(str, 10, type->isSignedIntegerType());
+  if (auto builtin = type->getAs<clang::BuiltinType>()) {
+    switch (builtin->getKind()) {
+      case clang::BuiltinType::UInt:
+        str += "U";
+        break;
+      case clang::BuiltinType::Long:
+        str += "L";
+        break;
+      case clang::BuiltinType::ULong:
+        str += "UL";
+        break;
+      case clang::BuiltinType::LongLong:
+        str += "LL";
+        break;
+      case clang::BuiltinType::ULongLong:
+        str += "ULL";
+        break;
+      default:
+        break;
+    }
+  }
+  return str.str().str();
+}
+
+static std::string GetFloatingString(const llvm::APFloat &val,
+                                     clang::QualType type) {
+  llvm::SmallString<32> str;
+  val.toString(str);
+  // Integral values have to be printed as floating-point constants
+  if (str.str().find_first_not_of("-0123456789") == llvm::StringRef::npos) {
+    str += ".";
+  }
+  if (auto builtin = type->getAs<clang::BuiltinType>()) {
+    switch (builtin->getKind()) {
+      case clang::BuiltinType::Float:
+        str += "F";
+        break;
+      case clang::BuiltinType::LongDouble:
+        str += "L";
+        break;
+      default:
+        break;
+    }
+  }
+  return str.str().str();
+}
+
+static std::string GetStorageClass(clang::StorageClass sc) {
+  if (sc == clang::SC_None) {
+    return "";
+  }
+  return std::string(clang::VarDecl::getStorageClassSpecifierString(sc)) + " ";
+}
+
+}  // namespace
+
+CEmitter::CEmitter(
+    clang::ASTContext &ctx,
+    const std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+        &data_inits)
+    : policy(ctx.getPrintingPolicy()), data_inits(data_inits), out(nullptr) {}
+
+void CEmitter::PushText(llvm::StringRef text) {
+  seq.push_back({Item::kText, text, "", nullptr, 0});
+}
+
+void CEmitter::PushString(std::string str) {
+  seq.push_back({Item::kString, "", std::move(str), nullptr, 0});
+}
+
+void CEmitter::PushIndent(unsigned indent) {
+  if (indent) {
+    seq.push_back({Item::kIndent, "", "", nullptr, indent});
+  }
+}
+
+void CEmitter::PushStmt(clang::Stmt *stmt, unsigned indent) {
+  seq.push_back({Item::kStmt, "", "", stmt, indent});
+}
+
+void CEmitter::PushBody(clang::Stmt *body, unsigned indent) {
+  seq.push_back({Item::kBody, "", "", body, indent});
+}
+
+void CEmitter::PushIfChain(clang::IfStmt *ifstmt, unsigned indent) {
+  seq.push_back({Item::kIfChain, "", "", ifstmt, indent});
+}
+
+void CEmitter::PushExpr(clang::Expr *expr) {
+  seq.push_back({Item::kExpr, "", "", expr, 0});
+}
+
+void CEmitter::PushChild(clang::Stmt *parent, unsigned index,
+                         clang::Expr *child) {
+  auto unop = clang::dyn_cast<clang::UnaryOperator>(parent);
+  auto sign = unop && (unop->getOpcode() == clang::UO_Minus ||
+                       unop->getOpcode() == clang::UO_Plus);
+  if (NeedsParens(parent, index, child) || (sign && HasSign(child))) {
+    PushText("(");
+    PushExpr(child);
+    PushText(")");
+  } else {
+    PushExpr(child);
+  }
+}
+
+void CEmitter::PushBodySep(clang::Stmt *body, unsigned indent) {
+  if (clang::isa<clang::CompoundStmt>(body)) {
+    PushText(" ");
+  } else {
+    PushIndent(indent);
+  }
+}
+
+void CEmitter::PushBodyEnd(clang::Stmt *body) {
+  if (clang::isa<clang::CompoundStmt>(body)) {
+    PushText("\n");
+  }
+}
+
+std::string CEmitter::GetDeclarator(clang::QualType type,
+                                    llvm::StringRef name) {
+  std::string str;
+  llvm::raw_string_ostream os(str);
+  type.print(os, policy, name);
+  return os.str();
+}
+
+std::string CEmitter::GetFunctionDeclarator(clang::FunctionDecl *fdecl) {
+  std::string str = fdecl->getNameAsString() + "(";
+  for (auto param : fdecl->parameters()) {
+    if (param != *fdecl->param_begin()) {
+      str += ", ";
+    }
+    str += GetDeclarator(param->getType(), param->getName());
+  }
+  if (fdecl->isVariadic()) {
+    str += fdecl->param_empty() ? "..." : ", ...";
+  } else if (fdecl->param_empty() && fdecl->hasPrototype()) {
+    str += "void";
+  }
+  str += ")";
+  return GetStorageClass(fdecl->getStorageClass()) +
+         GetDeclarator(fdecl->getReturnType(), str);
+}
+
+void CEmitter::ExpandStmt(clang::Stmt *stmt, unsigned indent) {
+  if (auto comp = clang::dyn_cast<clang::CompoundStmt>(stmt)) {
+    PushIndent(indent);
+    PushText("{\n");
+    for (auto child : comp->body()) {
+      PushStmt(child, indent + 1);
+    }
+    PushIndent(indent);
+    PushText("}\n");
+  } else if (auto ifstmt = clang::dyn_cast<clang::IfStmt>(stmt)) {
+    PushIndent(indent);
+    PushIfChain(ifstmt, indent);
+  } else if (auto loop = clang::dyn_cast<clang::WhileStmt>(stmt)) {
+    PushIndent(indent);
+    PushText("while (");
+    PushExpr(loop->getCond());
+    PushText(")");
+    PushBody(loop->getBody(), indent);
+    PushBodyEnd(loop->getBody());
+  } else if (auto loop = clang::dyn_cast<clang::DoStmt>(stmt)) {
+    PushIndent(indent);
+    PushText("do");
+    PushBody(loop->getBody(), indent);
+    PushBodySep(loop->getBody(), indent);
+    PushText("while (");
+    PushExpr(loop->getCond());
+    PushText(");\n");
+  } else if (clang::isa<clang::BreakStmt>(stmt)) {
+    PushIndent(indent);
+    PushText("break;\n");
+  } else if (clang::isa<clang::ContinueStmt>(stmt)) {
+    PushIndent(indent);
+    PushText("continue;\n");
+  } else if (auto ret = clang::dyn_cast<clang::ReturnStmt>(stmt)) {
+    PushIndent(indent);
+    if (auto value = ret->getRetValue()) {
+      PushText("return ");
+      PushExpr(value);
+      PushText(";\n");
+    } else {
+      PushText("return;\n");
+    }
+  } else if (clang::isa<clang::NullStmt>(stmt)) {
+    PushIndent(indent);
+    PushText(";\n");
+  } else if (auto decl_stmt = clang::dyn_cast<clang::DeclStmt>(stmt)) {
+    for (auto decl : decl_stmt->decls()) {
+      auto var = clang::dyn_cast<clang::VarDecl>(decl);
+      if (!var) {
+        std::string str;
+        llvm::raw_string_ostream os(str);
+        decl->print(os, policy);
+        PushIndent(indent);
+        PushString(os.str());
+        PushText(";\n");
+        continue;
+      }
+      PushIndent(indent);
+      PushString(GetStorageClass(var->getStorageClass()) +
+                 GetDeclarator(var->getType(), var->getName()));
+      if (auto init = var->getInit()) {
+        PushText(" = ");
+        PushExpr(init);
+      }
+      PushText(";\n");
+    }
+  } else if (auto expr = clang::dyn_cast<clang::Expr>(stmt)) {
+    PushIndent(indent);
+    PushExpr(expr);
+    PushText(";\n");
+  } else {
+    DLOG(WARNING) << "Printing unexpected statement with clang: "
+                  << stmt->getStmtClassName();
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    stmt->printPretty(os, nullptr, policy, indent);
+    PushString(os.str());
+  }
+}
+
+void CEmitter::ExpandBody(clang::Stmt *body, unsigned indent) {
+  if (auto comp = clang::dyn_cast<clang::CompoundStmt>(body)) {
+    PushText(" {\n");
+    for (auto child : comp->body()) {
+      PushStmt(child, indent + 1);
+    }
+    PushIndent(indent);
+    PushText("}");
+  } else {
+    PushText("\n");
+    PushStmt(body, indent + 1);
+  }
+}
+
+void CEmitter::ExpandIfChain(clang::IfStmt *ifstmt, unsigned indent) {
+  auto then = ifstmt->getThen();
+  PushText("if (");
+  PushExpr(ifstmt->getCond());
+  PushText(")");
+  PushBody(then, indent);
+  auto els = ifstmt->getElse();
+  if (!els) {
+    PushBodyEnd(then);
+    return;
+  }
+  PushBodySep(then, indent);
+  if (auto elif = clang::dyn_cast<clang::IfStmt>(els)) {
+    PushText("else ");
+    PushIfChain(elif, indent);
+  } else {
+    PushText("else");
+    PushBody(els, indent);
+    PushBodyEnd(els);
+  }
+}
+
+void CEmitter::ExpandExpr(clang::Expr *expr) {
+  if (auto paren = clang::dyn_cast<clang::ParenExpr>(expr)) {
+    PushText("(");
+    PushExpr(paren->getSubExpr());
+    PushText(")");
+  } else if (auto cast = clang::dyn_cast<clang::ImplicitCastExpr>(expr)) {
+    PushExpr(cast->getSubExpr());
+  } else if (auto cast = clang::dyn_cast<clang::CStyleCastExpr>(expr)) {
+    PushText("(");
+    PushString(cast->getTypeAsWritten().getAsString(policy));
+    PushText(")");
+    PushChild(cast, 0, cast->getSubExpr());
+  } else if (auto ref = clang::dyn_cast<clang::DeclRefExpr>(expr)) {
+    PushString(ref->getDecl()->getNameAsString());
+  } else if (auto lit = clang::dyn_cast<clang::IntegerLiteral>(expr)) {
+    PrintIntegerLiteral(lit);
+  } else if (auto lit = clang::dyn_cast<clang::CharacterLiteral>(expr)) {
+    PrintCharacterLiteral(lit);
+  } else if (auto lit = clang::dyn_cast<clang::FloatingLiteral>(expr)) {
+    PrintFloatingLiteral(lit);
+  } else if (auto lit = clang::dyn_cast<clang::StringLiteral>(expr)) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    lit->outputString(os);
+    PushString(os.str());
+  } else if (auto opaque = clang::dyn_cast<clang::OpaqueValueExpr>(expr)) {
+    auto iter = data_inits.find(opaque);
+    CHECK(iter != data_inits.end()) << "Opaque expression without data";
+    PrintData(iter->second, opaque->getType());
+  } else if (auto init_list = clang::dyn_cast<clang::InitListExpr>(expr)) {
+    PushText("{");
+    for (auto i = 0U; i < init_list->getNumInits(); ++i) {
+      if (i) {
+        PushText(", ");
+      }
+      PushChild(init_list, i, init_list->getInit(i));
+    }
+    PushText("}");
+  } else if (auto unop = clang::dyn_cast<clang::UnaryOperator>(expr)) {
+    auto opc = clang::UnaryOperator::getOpcodeStr(unop->getOpcode());
+    if (unop->isPostfix()) {
+      PushChild(unop, 0, unop->getSubExpr());
+      PushText(opc);
+    } else {
+      PushText(opc);
+      PushChild(unop, 0, unop->getSubExpr());
+    }
+  } else if (auto binop = clang::dyn_cast<clang::BinaryOperator>(expr)) {
+    PushChild(binop, 0, binop->getLHS());
+    if (binop->getOpcode() == clang::BO_Comma) {
+      PushText(", ");
+    } else {
+      PushText(" ");
+      PushText(binop->getOpcodeStr());
+      PushText(" ");
+    }
+    PushChild(binop, 1, binop->getRHS());
+  } else if (auto cond = clang::dyn_cast<clang::ConditionalOperator>(expr)) {
+    PushChild(cond, 0, cond->getCond());
+    PushText(" ? ");
+    PushChild(cond, 1, cond->getTrueExpr());
+    PushText(" : ");
+    PushChild(cond, 2, cond->getFalseExpr());
+  } else if (auto call = clang::dyn_cast<clang::CallExpr>(expr)) {
+    PushChild(call, 0, call->getCallee());
+    PushText("(");
+    for (auto i = 0U; i < call->getNumArgs(); ++i) {
+      if (i) {
+        PushText(", ");
+      }
+      PushChild(call, i + 1, call->getArg(i));
+    }
+    PushText(")");
+  } else if (auto sub = clang::dyn_cast<clang::ArraySubscriptExpr>(expr)) {
+    PushChild(sub, 0, sub->getLHS());
+    PushText("[");
+    PushChild(sub, 1, sub->getRHS());
+    PushText("]");
+  } else if (auto member = clang::dyn_cast<clang::MemberExpr>(expr)) {
+    PushChild(member, 0, member->getBase());
+    PushText(member->isArrow() ? "->" : ".");
+    PushString(member->getMemberDecl()->getNameAsString());
+  } else {
+    DLOG(WARNING) << "Printing unexpected expression with clang: "
+                  << expr->getStmtClassName();
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    expr->printPretty(os, nullptr, policy);
+    PushString(os.str());
+  }
+}
+
+void CEmitter::ExpandRecord(clang::RecordDecl *record) {
+  PushString(std::string(record->getKindName()));
+  if (record->getIdentifier()) {
+    PushText(" ");
+    PushString(record->getNameAsString());
+  }
+  if (!record->isCompleteDefinition()) {
+    PushText(";\n");
+    return;
+  }
+  PushText(" {\n");
+  for (auto field : record->fields()) {
+    PushIndent(1);
+    PushString(GetDeclarator(field->getType(), field->getName()));
+    if (field->isBitField()) {
+      PushText(" : ");
+      PushExpr(field->getBitWidth());
+    }
+    PushText(";\n");
+  }
+  PushText("};\n");
+}
+
+void CEmitter::PrintIntegerLiteral(clang::IntegerLiteral *lit) {
+  PushString(GetIntegerString(lit->getValue(), lit->getType()));
+}
+
+void CEmitter::PrintCharacterLiteral(clang::CharacterLiteral *lit) {
+  static const char kHex[] = "0123456789abcdef";
+  auto value = lit->getValue();
+  std::string str = "'";
+  switch (value) {
+    case '\0':
+      str += "\\0";
+      break;
+    case '\n':
+      str += "\\n";
+      break;
+    case '\t':
+      str += "\\t";
+      break;
+    case '\r':
+      str += "\\r";
+      break;
+    case '\'':
+      str += "\\'";
+      break;
+    case '\\':
+      str += "\\\\";
+      break;
+    default:
+      if (value >= 0x20 && value < 0x7f) {
+        str += static_cast<char>(value);
+      } else {
+        CHECK_LT(value, 0x100U) << "Character literal is not ASCII";
+        str += "\\x";
+        str += kHex[value >> 4];
+        str += kHex[value & 0xf];
+      }
+      break;
+  }
+  PushString(str + "'");
+}
+
+void CEmitter::PrintFloatingLiteral(clang::FloatingLiteral *lit) {
+  PushString(GetFloatingString(lit->getValue(), lit->getType()));
+}
+
+void CEmitter::PrintData(llvm::ConstantDataSequential *cdata,
+                         clang::QualType type) {
+  auto elm_type = cdata->getElementType();
+  auto elm_c_type = type->getAsArrayTypeUnsafe()->getElementType();
+  auto IsZero = [cdata, elm_type](unsigned i) {
+    if (elm_type->isIntegerTy()) {
+      return cdata->getElementAsInteger(i) == 0;
+    }
+    return cdata->getElementAsAPFloat(i).isPosZero();
+  };
+  // Elements after the last nonzero one are zero-initialized in C, which
+  // does not produce negative zero floats
+  auto num = cdata->getNumElements();
+  while (num && IsZero(num - 1)) {
+    --num;
+  }
+  std::string str = "{";
+  for (auto i = 0U; i < num; ++i) {
+    if (i) {
+      str += ", ";
+    }
+    if (elm_type->isIntegerTy()) {
+      llvm::APInt val(elm_type->getIntegerBitWidth(),
+                      cdata->getElementAsInteger(i));
+      str += GetIntegerString(val, elm_c_type);
+    } else {
+      str += GetFloatingString(cdata->getElementAsAPFloat(i), elm_c_type);
+    }
+  }
+  PushString(str + "}");
+}
+
+void CEmitter::Schedule() {
+  for (auto it = seq.rbegin(); it != seq.rend(); ++it) {
+    stack.push_back(std::move(*it));
+  }
+  seq.clear();
+}
+
+void CEmitter::Run() {
+  Schedule();
+  while (!stack.empty()) {
+    auto item = std::move(stack.back());
+    stack.pop_back();
+    switch (item.kind) {
+      case Item::kText:
+        out->append(item.text.data(), item.text.size());
+        continue;
+      case Item::kString:
+        out->append(item.str);
+        continue;
+      case Item::kIndent:
+        out->append(item.indent * policy.Indentation, ' ');
+        continue;
+      case Item::kStmt:
+        ExpandStmt(item.stmt, item.indent);
+        break;
+      case Item::kBody:
+        ExpandBody(item.stmt, item.indent);
+        break;
+      case Item::kIfChain:
+        ExpandIfChain(clang::cast<clang::IfStmt>(item.stmt), item.indent);
+        break;
+      case Item::kExpr:
+        ExpandExpr(clang::cast<clang::Expr>(item.stmt));
+        break;
+    }
+    Schedule();
+  }
+}
+
+void CEmitter::EmitDecl(clang::Decl *decl, std::string &output) {
+  out = &output;
+  if (auto fdecl = clang::dyn_cast<clang::FunctionDecl>(decl)) {
+    PushString(GetFunctionDeclarator(fdecl));
+    if (fdecl->doesThisDeclarationHaveABody()) {
+      PushText(" ");
+      PushStmt(fdecl->getBody(), 0);
+    } else {
+      PushText(";\n");
+    }
+  } else if (auto var = clang::dyn_cast<clang::VarDecl>(decl)) {
+    PushString(GetStorageClass(var->getStorageClass()) +
+               GetDeclarator(var->getType(), var->getName()));
+    if (auto init = var->getInit()) {
+      PushText(" = ");
+      PushExpr(init);
+    }
+    PushText(";\n");
+  } else if (auto record = clang::dyn_cast<clang::RecordDecl>(decl)) {
+    ExpandRecord(record);
+  } else {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    decl->print(os, policy);
+    PushString(os.str());
+    PushText(";\n");
+  }
+  Run();
+  out = nullptr;
+}
+
+void EmitTranslationUnit(
+    clang::ASTContext &ctx,
+    const std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+        &data_inits,
+    llvm::raw_ostream &os) {
+  CEmitter emitter(ctx, data_inits);
+  std::string buffer;
+  buffer.reserve(kFlushSize);
+  for (auto decl : ctx.getTranslationUnitDecl()->decls()) {
+    if (decl->isImplicit()) {
+      continue;
+    }
+    emitter.EmitDecl(decl, buffer);
+    if (buffer.size() >= kFlushSize) {
+      os.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
+  os.write(buffer.data(), buffer.size());
+}
+
+}  // namespace rellic
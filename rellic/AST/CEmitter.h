@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Expr.h>
+#include <clang/AST/Stmt.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rellic {
+
+// Prints the subset of C that the decompiler generates. Statements and
+// expressions are expanded from an explicit stack instead of recursively,
+// and parentheses are added where C precedence requires them, so the AST
+// does not need `ParenExpr`s. Declarations are printed independently of
+// each other. Types and constructs outside of that subset are printed by
+// clang's printers.
+class CEmitter {
+ private:
+  struct Item {
+    enum Kind { kText, kString, kIndent, kStmt, kBody, kIfChain, kExpr };
+    Kind kind;
+    llvm::StringRef text;
+    std::string str;
+    clang::Stmt *stmt;
+    unsigned indent;
+  };
+
+  clang::PrintingPolicy policy;
+  // Constant data that opaque expressions stand for
+  const std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+      &data_inits;
+  // Output of the declaration that is being printed
+  std::string *out;
+  // Items that are left to print, in reverse order
+  std::vector<Item> stack;
+  // Items of the node that is being expanded, in order
+  std::vector<Item> seq;
+
+  void PushText(llvm::StringRef text);
+  void PushString(std::string str);
+  void PushIndent(unsigned indent);
+  void PushStmt(clang::Stmt *stmt, unsigned indent);
+  void PushBody(clang::Stmt *body, unsigned indent);
+  void PushIfChain(clang::IfStmt *ifstmt, unsigned indent);
+  void PushExpr(clang::Expr *expr);
+  // Pushes `child`, the `index`-th child of `parent`, in parentheses if
+  // they are needed
+  void PushChild(clang::Stmt *parent, unsigned index, clang::Expr *child);
+  // Separates `body` from a following `else` or `while`
+  void PushBodySep(clang::Stmt *body, unsigned indent);
+  // Ends the line of `body` if it is a compound
+  void PushBodyEnd(clang::Stmt *body);
+
+  std::string GetDeclarator(clang::QualType type, llvm::StringRef name);
+  std::string GetFunctionDeclarator(clang::FunctionDecl *fdecl);
+
+  void ExpandStmt(clang::Stmt *stmt, unsigned indent);
+  void ExpandBody(clang::Stmt *body, unsigned indent);
+  void ExpandIfChain(clang::IfStmt *ifstmt, unsigned indent);
+  void ExpandExpr(clang::Expr *expr);
+  void ExpandRecord(clang::RecordDecl *record);
+
+  void PrintIntegerLiteral(clang::IntegerLiteral *lit);
+  void PrintCharacterLiteral(clang::CharacterLiteral *lit);
+  void PrintFloatingLiteral(clang::FloatingLiteral *lit);
+  // Prints the initializer list of `cdata`, whose C type is `type`,
+  // straight from its buffer
+  void PrintData(llvm::ConstantDataSequential *cdata, clang::QualType type);
+
+  // Moves the items of `seq` to `stack`
+  void Schedule();
+  // Prints the items of `stack`
+  void Run();
+
+ public:
+  CEmitter(
+      clang::ASTContext &ctx,
+      const std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+          &data_inits);
+
+  // Appends `decl` to `output`
+  void EmitDecl(clang::Decl *decl, std::string &output);
+};
+
+// Prints the declarations of the translation unit of `ctx` to `os`.
+// Opaque expressions are printed as the constant data in `data_inits`. The
+// output is buffered and written in large blocks.
+void EmitTranslationUnit(
+    clang::ASTContext &ctx,
+    const std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+        &data_inits,
+    llvm::raw_ostream &os);
+
+}  // namespace rellic
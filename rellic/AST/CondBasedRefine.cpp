@@ -18,6 +18,7 @@
 #include <glog/logging.h>
 
 #include "rellic/AST/CondBasedRefine.h"
+#include "rellic/AST/Z3QueryLog.h"
 
 namespace rellic {
 
@@ -28,7 +29,7 @@ using IfStmtVec = std::vector<clang::IfStmt *>;
 static IfStmtVec GetIfStmts(clang::CompoundStmt *compound) {
   IfStmtVec result;
   for (auto stmt : compound->body()) {
-    if (auto ifstmt = clang::dyn_cast<clang::IfStmt>(stmt)) {
+    if (auto ifstmt = clang::dyn_cast_or_null<clang::IfStmt>(stmt)) {
       result.push_back(ifstmt);
     }
   }
@@ -56,14 +57,24 @@ char CondBasedRefine::ID = 0;
 CondBasedRefine::CondBasedRefine(clang::ASTContext &ctx,
                                  rellic::IRToASTVisitor &ast_gen)
     : ModulePass(CondBasedRefine::ID),
-      ast_ctx(&ctx),
+      TransformVisitor<CondBasedRefine>(ctx),
       ast_gen(&ast_gen),
       z3_ctx(new z3::context()),
       z3_gen(new rellic::Z3ConvVisitor(ast_ctx, z3_ctx.get())) {}
 
+void CondBasedRefine::ResetZ3Context() {
+  // Release the converter before the context it refers to
+  z3_gen.reset();
+  z3_ctx.reset(new z3::context());
+  z3_gen.reset(new rellic::Z3ConvVisitor(ast_ctx, z3_ctx.get()));
+}
+
 bool CondBasedRefine::ThenTest(z3::expr lhs, z3::expr rhs) {
-  auto Pred = [](z3::expr a, z3::expr b) {
-    auto test = (!a && b).simplify();
+  auto Pred = [this](z3::expr a, z3::expr b) {
+    Z3QueryTimer timer;
+    auto query = !a && b;
+    auto test = query.simplify();
+    timer.Finish(query, "simplify", GetState().function, nullptr);
     return test.bool_value() != Z3_L_FALSE;
   };
 
@@ -83,8 +94,11 @@ bool CondBasedRefine::ThenTest(z3::expr lhs, z3::expr rhs) {
 }
 
 bool CondBasedRefine::ElseTest(z3::expr lhs, z3::expr rhs) {
-  auto Pred = [](z3::expr a, z3::expr b) {
-    auto test = (a || b).simplify();
+  auto Pred = [this](z3::expr a, z3::expr b) {
+    Z3QueryTimer timer;
+    auto query = a || b;
+    auto test = query.simplify();
+    timer.Finish(query, "simplify", GetState().function, nullptr);
     return test.bool_value() != Z3_L_TRUE;
   };
 
@@ -106,7 +120,10 @@ bool CondBasedRefine::ElseTest(z3::expr lhs, z3::expr rhs) {
 z3::expr CondBasedRefine::GetZ3Cond(clang::IfStmt *ifstmt) {
   auto cond = ifstmt->getCond();
   auto expr = z3_gen->Z3BoolCast(z3_gen->GetOrCreateZ3Expr(cond));
-  return expr.simplify();
+  Z3QueryTimer timer;
+  auto result = expr.simplify();
+  timer.Finish(expr, "simplify", GetState().function, ifstmt);
+  return result;
 }
 
 void CondBasedRefine::CreateIfThenElseStmts(IfStmtVec worklist) {
@@ -116,7 +133,9 @@ void CondBasedRefine::CreateIfThenElseStmts(IfStmtVec worklist) {
       worklist.erase(it);
     }
   };
-  
+  // Statements that get erased or replaced in the parent compound
+  StmtMap substitutions;
+
   while (!worklist.empty()) {
     auto lhs = *worklist.begin();
     RemoveFromWorkList(lhs);
@@ -164,23 +183,30 @@ void CondBasedRefine::CreateIfThenElseStmts(IfStmtVec worklist) {
       }
     }
   }
+  // Apply substitutions
+  for (auto sub : substitutions) {
+    if (sub.second) {
+      ReplaceStmt(sub.first, sub.second);
+    } else {
+      EraseStmt(sub.first);
+    }
+  }
+}
+
+bool CondBasedRefine::VisitFunctionDecl(clang::FunctionDecl *fdecl) {
+  // Traversal is in post-order, so the compounds of the body have been
+  // refined at this point and this drops the expressions of the current
+  // function
+  if (z3_gen->FinishFunction()) {
+    ResetZ3Context();
+  }
+  return TransformVisitor<CondBasedRefine>::VisitFunctionDecl(fdecl);
 }
 
 bool CondBasedRefine::VisitCompoundStmt(clang::CompoundStmt *compound) {
   // DLOG(INFO) << "VisitCompoundStmt";
   // Create if-then-else substitutions for IfStmts in `compound`
   CreateIfThenElseStmts(GetIfStmts(compound));
-  // Apply created if-then-else substitutions and
-  // create a replacement for `compound`
-  if (ReplaceChildren(compound, substitutions)) {
-    std::vector<clang::Stmt *> new_body;
-    for (auto stmt : compound->body()) {
-      if (stmt) {
-        new_body.push_back(stmt);
-      }
-    }
-    substitutions[compound] = CreateCompoundStmt(*ast_ctx, new_body);
-  }
   return true;
 }
 
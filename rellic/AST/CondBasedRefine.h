@@ -30,11 +30,12 @@ namespace rellic {
 class CondBasedRefine : public llvm::ModulePass,
                         public TransformVisitor<CondBasedRefine> {
  private:
-  clang::ASTContext *ast_ctx;
   rellic::IRToASTVisitor *ast_gen;
   std::unique_ptr<z3::context> z3_ctx;
   std::unique_ptr<rellic::Z3ConvVisitor> z3_gen;
 
+  void ResetZ3Context();
+
   z3::expr GetZ3Cond(clang::IfStmt *ifstmt);
 
   bool ThenTest(z3::expr lhs, z3::expr rhs);
@@ -49,6 +50,7 @@ class CondBasedRefine : public llvm::ModulePass,
 
   CondBasedRefine(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen);
 
+  bool VisitFunctionDecl(clang::FunctionDecl *fdecl);
   bool VisitCompoundStmt(clang::CompoundStmt *compound);
 
   bool runOnModule(llvm::Module &module) override;
@@ -27,7 +27,7 @@ char DeadStmtElim::ID = 0;
 DeadStmtElim::DeadStmtElim(clang::ASTContext &ctx,
                            rellic::IRToASTVisitor &ast_gen)
     : ModulePass(DeadStmtElim::ID),
-      ast_ctx(&ctx),
+      TransformVisitor<DeadStmtElim>(ctx),
       ast_gen(&ast_gen) {}
 
 bool DeadStmtElim::VisitIfStmt(clang::IfStmt *ifstmt) {
@@ -37,31 +37,19 @@ bool DeadStmtElim::VisitIfStmt(clang::IfStmt *ifstmt) {
   auto compound = clang::dyn_cast<clang::CompoundStmt>(ifstmt->getThen());
   bool is_empty = compound ? compound->body_empty() : false;
   if ((is_const && !val.getBoolValue()) || is_empty) {
-    substitutions[ifstmt] = nullptr;
+    EraseStmt(ifstmt);
   }
   return true;
 }
 
 bool DeadStmtElim::VisitCompoundStmt(clang::CompoundStmt *compound) {
   // DLOG(INFO) << "VisitCompoundStmt";
-  std::vector<clang::Stmt *> new_body;
   for (auto stmt : compound->body()) {
-    // Filter out nullptr statements
-    if (!stmt) {
-      continue;
+    // Erase expressions that are computed only for their value
+    auto expr = clang::dyn_cast_or_null<clang::Expr>(stmt);
+    if (expr && !expr->HasSideEffects(*ast_ctx)) {
+      EraseStmt(expr);
     }
-    // Add only necessary statements
-    if (auto expr = clang::dyn_cast<clang::Expr>(stmt)) {
-      if (expr->HasSideEffects(*ast_ctx)) {
-        new_body.push_back(stmt);
-      }
-    } else {
-      new_body.push_back(stmt);
-    }
-  }
-  // Create the a new compound
-  if (changed || new_body.size() < compound->size()) {
-    substitutions[compound] = CreateCompoundStmt(*ast_ctx, new_body);
   }
   return true;
 }
@@ -27,7 +27,6 @@ namespace rellic {
 class DeadStmtElim : public llvm::ModulePass,
                      public TransformVisitor<DeadStmtElim> {
  private:
-  clang::ASTContext *ast_ctx;
   rellic::IRToASTVisitor *ast_gen;
 
  public:
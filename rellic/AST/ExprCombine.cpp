@@ -25,23 +25,16 @@ namespace rellic {
 
 namespace {
 
-using namespace clang::ast_matchers;
-
-static const auto zero_int_lit = integerLiteral(equals(0));
+using namespace rellic::pattern;
 
 // Matches `(&base)[0]` and subs it for `base`
 class ArraySubscriptAddrOfRule : public InferenceRule {
  public:
-  ArraySubscriptAddrOfRule()
-      : InferenceRule(arraySubscriptExpr(
-            stmt().bind("sub"),
-            hasBase(parenExpr(has(unaryOperator(stmt().bind("base"))))),
-            hasIndex(zero_int_lit))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    auto op = result.Nodes.getNodeAs<clang::UnaryOperator>("base");
-    if (op->getOpcode() == clang::UO_AddrOf) {
-      match = result.Nodes.getNodeAs<clang::ArraySubscriptExpr>("sub");
+  void FindMatch(clang::Stmt *stmt) override {
+    auto addr_of = m_UnOp(clang::UO_AddrOf, m_Any());
+    if (Matches(stmt, m_ArraySubscript(m_IgnoreParenImpCasts(addr_of),
+                                       m_IntLit(0)))) {
+      match = stmt;
     }
   }
 
@@ -50,8 +43,8 @@ class ArraySubscriptAddrOfRule : public InferenceRule {
     auto sub = clang::cast<clang::ArraySubscriptExpr>(stmt);
     CHECK(sub == match) << "Substituted ArraySubscriptExpr is not the matched "
                            "ArraySubscriptExpr!";
-    auto paren = clang::cast<clang::ParenExpr>(sub->getBase());
-    auto addr_of = clang::cast<clang::UnaryOperator>(paren->getSubExpr());
+    auto base = sub->getBase()->IgnoreParenImpCasts();
+    auto addr_of = clang::cast<clang::UnaryOperator>(base);
     return addr_of->getSubExpr();
   }
 };
@@ -59,14 +52,12 @@ class ArraySubscriptAddrOfRule : public InferenceRule {
 // Matches `&base[0]` and subs it for `base`
 class AddrOfArraySubscriptRule : public InferenceRule {
  public:
-  AddrOfArraySubscriptRule()
-      : InferenceRule(
-            unaryOperator(stmt().bind("addr_of"), hasOperatorName("&"),
-                          has(ignoringParenImpCasts(
-                              arraySubscriptExpr(hasIndex(zero_int_lit)))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    match = result.Nodes.getNodeAs<clang::UnaryOperator>("addr_of");
+  void FindMatch(clang::Stmt *stmt) override {
+    if (Matches(stmt, m_UnOp(clang::UO_AddrOf,
+                             m_IgnoreParenImpCasts(m_ArraySubscript(
+                                 m_Any(), m_IntLit(0)))))) {
+      match = stmt;
+    }
   }
 
   clang::Stmt *GetOrCreateSubstitution(clang::ASTContext &ctx,
@@ -83,13 +74,12 @@ class AddrOfArraySubscriptRule : public InferenceRule {
 // Matches `*&expr` and subs it for `expr`
 class DerefAddrOfRule : public InferenceRule {
  public:
-  DerefAddrOfRule()
-      : InferenceRule(unaryOperator(
-            stmt().bind("deref"), hasOperatorName("*"),
-            has(ignoringParenImpCasts(unaryOperator(hasOperatorName("&")))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    match = result.Nodes.getNodeAs<clang::UnaryOperator>("deref");
+  void FindMatch(clang::Stmt *stmt) override {
+    if (Matches(stmt, m_UnOp(clang::UO_Deref,
+                             m_IgnoreParenImpCasts(
+                                 m_UnOp(clang::UO_AddrOf, m_Any()))))) {
+      match = stmt;
+    }
   }
 
   clang::Stmt *GetOrCreateSubstitution(clang::ASTContext &ctx,
@@ -106,16 +96,10 @@ class DerefAddrOfRule : public InferenceRule {
 // Matches `!(comp)` and subs it for `negcomp`
 class NegComparisonRule : public InferenceRule {
  public:
-  NegComparisonRule()
-      : InferenceRule(unaryOperator(
-            stmt().bind("not"), hasOperatorName("!"),
-            has(ignoringParenImpCasts(binaryOperator(stmt().bind("binop")))))) {
-  }
-
-  void run(const MatchFinder::MatchResult &result) {
-    auto binop = result.Nodes.getNodeAs<clang::BinaryOperator>("binop");
-    if (binop->isComparisonOp()) {
-      match = result.Nodes.getNodeAs<clang::UnaryOperator>("not");
+  void FindMatch(clang::Stmt *stmt) override {
+    if (Matches(stmt, m_UnOp(clang::UO_LNot,
+                             m_IgnoreParenImpCasts(m_Comparison())))) {
+      match = stmt;
     }
   }
 
@@ -132,40 +116,13 @@ class NegComparisonRule : public InferenceRule {
   }
 };
 
-// Matches `(a)` and subs it for `a`
-class ParenDeclRefExprStripRule : public InferenceRule {
- public:
-  ParenDeclRefExprStripRule()
-      : InferenceRule(
-            parenExpr(stmt().bind("paren"),
-                      has(ignoringImpCasts(declRefExpr(to(varDecl())))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    match = result.Nodes.getNodeAs<clang::ParenExpr>("paren");
-  }
-
-  clang::Stmt *GetOrCreateSubstitution(clang::ASTContext &ctx,
-                                       clang::Stmt *stmt) {
-    auto paren = clang::cast<clang::ParenExpr>(stmt);
-    CHECK(paren == match)
-        << "Substituted ParenExpr is not the matched ParenExpr!";
-    return paren->getSubExpr();
-  }
-};
-
 // Matches `(&expr)->field` and subs it for `expr.field`
 class MemberExprAddrOfRule : public InferenceRule {
  public:
-  MemberExprAddrOfRule()
-      : InferenceRule(memberExpr(
-            stmt().bind("arrow"), isArrow(),
-            has(expr(stmt().bind("base"), ignoringParenImpCasts(unaryOperator(
-                                              hasOperatorName("&"))))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    auto arrow = result.Nodes.getNodeAs<clang::MemberExpr>("arrow");
-    if (result.Nodes.getNodeAs<clang::Expr>("base") == arrow->getBase()) {
-      match = arrow;
+  void FindMatch(clang::Stmt *stmt) override {
+    if (Matches(stmt, m_Arrow(m_IgnoreParenImpCasts(
+                          m_UnOp(clang::UO_AddrOf, m_Any()))))) {
+      match = stmt;
     }
   }
 
@@ -187,31 +144,20 @@ char ExprCombine::ID = 0;
 
 ExprCombine::ExprCombine(clang::ASTContext &ctx,
                          rellic::IRToASTVisitor &ast_gen)
-    : ModulePass(ExprCombine::ID), ast_ctx(&ctx), ast_gen(&ast_gen) {}
-
-bool ExprCombine::VisitParenExpr(clang::ParenExpr *paren) {
-  // DLOG(INFO) << "VisitParenExpr";
-  std::vector<InferenceRule *> rules({new ParenDeclRefExprStripRule});
-  auto sub = ApplyFirstMatchingRule(*ast_ctx, paren, rules);
-  if (sub != paren) {
-    substitutions[paren] = sub;
-  }
-
-  delete rules.back();
-
-  return true;
-}
+    : ModulePass(ExprCombine::ID),
+      TransformVisitor<ExprCombine>(ctx),
+      ast_gen(&ast_gen) {}
 
 bool ExprCombine::VisitArraySubscriptExpr(clang::ArraySubscriptExpr *expr) {
   // DLOG(INFO) << "VisitArraySubscriptExpr";
   std::vector<InferenceRule *> rules({new ArraySubscriptAddrOfRule});
   auto sub = ApplyFirstMatchingRule(*ast_ctx, expr, rules);
+  delete rules.back();
+
   if (sub != expr) {
-    substitutions[expr] = sub;
+    return ReplaceAndVisit(expr, sub);
   }
 
-  delete rules.back();
-
   return true;
 }
 
@@ -224,14 +170,14 @@ bool ExprCombine::VisitUnaryOperator(clang::UnaryOperator *op) {
   rules.push_back(new AddrOfArraySubscriptRule);
 
   auto sub = ApplyFirstMatchingRule(*ast_ctx, op, rules);
-  if (sub != op) {
-    substitutions[op] = sub;
-  }
-
   for (auto rule : rules) {
     delete rule;
   }
 
+  if (sub != op) {
+    return ReplaceAndVisit(op, sub);
+  }
+
   return true;
 }
 
@@ -239,12 +185,12 @@ bool ExprCombine::VisitMemberExpr(clang::MemberExpr *expr) {
   // DLOG(INFO) << "VisitArraySubscriptExpr";
   std::vector<InferenceRule *> rules({new MemberExprAddrOfRule});
   auto sub = ApplyFirstMatchingRule(*ast_ctx, expr, rules);
+  delete rules.back();
+
   if (sub != expr) {
-    substitutions[expr] = sub;
+    return ReplaceAndVisit(expr, sub);
   }
 
-  delete rules.back();
-
   return true;
 }
 
@@ -27,7 +27,6 @@ namespace rellic {
 class ExprCombine : public llvm::ModulePass,
                     public TransformVisitor<ExprCombine> {
  private:
-  clang::ASTContext *ast_ctx;
   rellic::IRToASTVisitor *ast_gen;
 
  public:
@@ -38,7 +37,6 @@ class ExprCombine : public llvm::ModulePass,
   bool VisitUnaryOperator(clang::UnaryOperator *op);
   bool VisitArraySubscriptExpr(clang::ArraySubscriptExpr *expr);
   bool VisitMemberExpr(clang::MemberExpr *expr);
-  bool VisitParenExpr(clang::ParenExpr *paren);
 
   bool runOnModule(llvm::Module &module) override;
 };
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <llvm/IR/Module.h>
+
+#include "rellic/AST/IRToASTVisitor.h"
+#include "rellic/AST/TransformVisitor.h"
+
+namespace rellic {
+
+template <typename... Passes>
+class PassChain;
+
+template <>
+class PassChain<> {
+ public:
+  PassChain(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen) {}
+
+  void Initialize(TransformState &state) {}
+  bool Visit(TransformState &state) { return true; }
+  bool IsChanged() { return false; }
+};
+
+// Statically linked list of passes that edit the AST through one state
+template <typename Pass, typename... Rest>
+class PassChain<Pass, Rest...> {
+ private:
+  Pass pass;
+  PassChain<Rest...> rest;
+
+ public:
+  PassChain(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen)
+      : pass(ctx, ast_gen), rest(ctx, ast_gen) {}
+
+  void Initialize(TransformState &state) {
+    pass.SetState(state);
+    pass.Initialize();
+    rest.Initialize(state);
+  }
+
+  // Visits the current statement of `state` with every pass. A pass visits
+  // the replacement of the statement if an earlier pass replaced it.
+  bool Visit(TransformState &state) {
+    if (!state.visited) {
+      // Erased by an earlier pass
+      return true;
+    }
+    return WalkUpFromAnyStmt(pass, state.visited) && rest.Visit(state);
+  }
+
+  bool IsChanged() { return pass.IsChanged() || rest.IsChanged(); }
+};
+
+// Runs the local rewrites of several `TransformVisitor` passes in a single
+// post-order traversal instead of one traversal per pass. The passes are
+// composed at compile time, so there is no virtual dispatch per statement.
+template <typename... Passes>
+class FusedTransform : public llvm::ModulePass,
+                       public TransformVisitor<FusedTransform<Passes...>> {
+ private:
+  using Base = TransformVisitor<FusedTransform<Passes...>>;
+
+  PassChain<Passes...> passes;
+
+ public:
+  static char ID;
+
+  FusedTransform(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen)
+      : ModulePass(FusedTransform::ID), Base(ctx), passes(ctx, ast_gen) {}
+
+  bool dataTraverseStmtPost(clang::Stmt *stmt) {
+    Base::dataTraverseStmtPost(stmt);
+    return passes.Visit(Base::GetState());
+  }
+
+  // Child compounds are rebuilt by the fused passes. `stmt` may not be in
+  // the AST anymore at this point.
+  bool VisitStmt(clang::Stmt *stmt) { return true; }
+
+  bool runOnModule(llvm::Module &module) override {
+    LOG(INFO) << "Running fused passes";
+    Base::Initialize();
+    passes.Initialize(Base::GetState());
+    Base::TraverseDecl(Base::ast_ctx->getTranslationUnitDecl());
+    return passes.IsChanged();
+  }
+};
+
+template <typename... Passes>
+char FusedTransform<Passes...>::ID = 0;
+
+template <typename... Passes>
+llvm::ModulePass *createFusedTransformPass(clang::ASTContext &ctx,
+                                          rellic::IRToASTVisitor &ast_gen) {
+  return new FusedTransform<Passes...>(ctx, ast_gen);
+}
+
+}  // namespace rellic
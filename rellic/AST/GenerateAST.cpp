@@ -143,8 +143,7 @@ clang::Expr *GenerateAST::CreateEdgeCond(llvm::BasicBlock *from,
       auto br = llvm::cast<llvm::BranchInst>(term);
       if (br->isConditional()) {
         // Get the edge condition
-        result = clang::cast<clang::Expr>(
-            ast_gen->GetOrCreateStmt(br->getCondition()));
+        result = ast_gen->GetBranchCondExpr(br);
         // Negate if `br` jumps to `to` when `expr` is false
         if (to == br->getSuccessor(1)) {
           result = CreateNotExpr(*ast_ctx, result);
@@ -201,10 +200,43 @@ clang::Expr *GenerateAST::GetOrCreateReachingCond(llvm::BasicBlock *block) {
 StmtVec GenerateAST::CreateBasicBlockStmts(llvm::BasicBlock *block) {
   StmtVec result;
   for (auto &inst : *block) {
+    // PHI nodes are assigned at the end of their predecessors
+    if (llvm::isa<llvm::PHINode>(inst)) {
+      continue;
+    }
     if (auto stmt = ast_gen->GetOrCreateStmt(&inst)) {
       result.push_back(stmt);
     }
   }
+  // Assign the PHI nodes of the successor that is branched to
+  auto br = llvm::dyn_cast<llvm::BranchInst>(block->getTerminator());
+  if (!br) {
+    return result;
+  }
+  // Save the condition before the copies reassign it
+  if (auto save = ast_gen->CreateBranchCondSave(br)) {
+    result.push_back(save);
+  }
+  auto then_copies = ast_gen->CreatePHICopies(block, br->getSuccessor(0));
+  if (br->isUnconditional() || br->getSuccessor(0) == br->getSuccessor(1)) {
+    result.insert(result.end(), then_copies.begin(), then_copies.end());
+    return result;
+  }
+  auto else_copies = ast_gen->CreatePHICopies(block, br->getSuccessor(1));
+  if (then_copies.empty() && else_copies.empty()) {
+    return result;
+  }
+  auto cond = ast_gen->GetBranchCondExpr(br);
+  if (then_copies.empty()) {
+    cond = CreateNotExpr(*ast_ctx, cond);
+    std::swap(then_copies, else_copies);
+  }
+  auto ifstmt =
+      CreateIfStmt(*ast_ctx, cond, CreateCompoundStmt(*ast_ctx, then_copies));
+  if (!else_copies.empty()) {
+    ifstmt->setElse(CreateCompoundStmt(*ast_ctx, else_copies));
+  }
+  result.push_back(ifstmt);
   return result;
 }
 
@@ -390,6 +422,8 @@ bool GenerateAST::runOnModule(llvm::Module &module) {
     }
     // Clear the region statements from previous functions
     region_stmts.clear();
+    // Turn PHI nodes into variables
+    ast_gen->LowerPHINodes(func);
     // Get dominator tree
     domtree = &getAnalysis<llvm::DominatorTreeWrapperPass>(func).getDomTree();
     // Get single-entry, single-exit regions
@@ -421,8 +455,15 @@ bool GenerateAST::runOnModule(llvm::Module &module) {
     tudecl->addDecl(fdefn);
     // Set parameters to the same as the previous declaration
     fdefn->setParams(fdecl->parameters());
-    // Set body to the compound of the top-level region
-    fdefn->setBody(region_stmts[regions->getTopLevelRegion()]);
+    // Set body to the compound of the top-level region, preceded by the
+    // declarations of temporaries
+    auto body = region_stmts[regions->getTopLevelRegion()];
+    auto temps = ast_gen->GetTemporaryDecls(func);
+    if (!temps.empty()) {
+      temps.insert(temps.end(), body->body_begin(), body->body_end());
+      body = CreateCompoundStmt(*ast_ctx, temps);
+    }
+    fdefn->setBody(body);
   }
 
   return true;
@@ -25,28 +25,75 @@
 #include "rellic/AST/IRToASTVisitor.h"
 #include "rellic/AST/Util.h"
 
+#include <cctype>
 #include <iterator>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+DEFINE_uint32(temp_min_uses, 0,
+              "Store instruction results with at least this many uses in "
+              "temporary variables; 0 inlines every result at its uses.");
+DEFINE_uint32(temp_min_size, 4,
+              "Minimum size, in AST nodes, of an expression that is stored "
+              "in a temporary variable.");
 
 namespace rellic {
 
 namespace {
 
-template <typename T>
-static size_t GetNumDecls(clang::DeclContext *decl_ctx) {
-  size_t result = 0;
-  for (auto decl : decl_ctx->decls()) {
-    if (clang::isa<T>(decl)) {
-      ++result;
+// Counts the nodes of `stmt`, up to `limit`
+static unsigned CountNodes(clang::Stmt *stmt, unsigned limit) {
+  unsigned result = 0;
+  std::vector<clang::Stmt *> worklist{stmt};
+  while (!worklist.empty() && result < limit) {
+    auto node = worklist.back();
+    worklist.pop_back();
+    ++result;
+    for (auto child : node->children()) {
+      if (child) {
+        worklist.push_back(child);
+      }
     }
   }
   return result;
 }
 
+// Whether `expr` refers to one of `vars`
+static bool RefersTo(clang::Expr *expr,
+                     const std::unordered_set<clang::VarDecl *> &vars) {
+  if (vars.empty()) {
+    return false;
+  }
+  std::vector<clang::Stmt *> worklist{expr};
+  while (!worklist.empty()) {
+    auto node = worklist.back();
+    worklist.pop_back();
+    if (auto ref = clang::dyn_cast<clang::DeclRefExpr>(node)) {
+      auto var = clang::dyn_cast<clang::VarDecl>(ref->getDecl());
+      if (var && vars.count(var)) {
+        return true;
+      }
+    }
+    for (auto child : node->children()) {
+      if (child) {
+        worklist.push_back(child);
+      }
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 IRToASTVisitor::IRToASTVisitor(clang::ASTContext &ctx) : ast_ctx(ctx) {}
 
 clang::QualType IRToASTVisitor::GetQualType(llvm::Type *type) {
+  auto it = types.find(type);
+  if (it != types.end()) {
+    return it->second;
+  }
+
   DLOG(INFO) << "GetQualType: " << LLVMThingToString(type);
   clang::QualType result;
   switch (type->getTypeID()) {
@@ -106,8 +153,7 @@ clang::QualType IRToASTVisitor::GetQualType(llvm::Type *type) {
         auto strct = llvm::cast<llvm::StructType>(type);
         auto sname = strct->getName().str();
         if (sname.empty()) {
-          auto num = GetNumDecls<clang::TypeDecl>(tudecl);
-          sname = "struct_" + std::to_string(num);
+          sname = CreateUniqueName(tudecl, "struct_");
         }
         // Create a C struct declaration
         auto sid = CreateIdentifier(ast_ctx, sname);
@@ -134,7 +180,43 @@ clang::QualType IRToASTVisitor::GetQualType(llvm::Type *type) {
   }
 
   CHECK(!result.isNull()) << "Unknown LLVM Type";
+  // Recursive calls may have rehashed `types`
+  types[type] = result;
+
+  return result;
+}
+
+clang::Expr *IRToASTVisitor::CreateIntegerLiteralExpr(llvm::APInt val,
+                                                      clang::QualType type) {
+  clang::Expr *result = nullptr;
+  switch (clang::cast<clang::BuiltinType>(type)->getKind()) {
+    case clang::BuiltinType::Kind::UChar:
+    case clang::BuiltinType::Kind::SChar:
+      result = CreateCharacterLiteral(ast_ctx, val, type);
+      break;
+
+    case clang::BuiltinType::Kind::Bool:
+      result = CreateIntegerLiteral(ast_ctx, val, ast_ctx.IntTy);
+      break;
 
+    case clang::BuiltinType::Kind::Short:
+    case clang::BuiltinType::Kind::UShort:
+    case clang::BuiltinType::Kind::Int:
+    case clang::BuiltinType::Kind::UInt:
+    case clang::BuiltinType::Kind::Long:
+    case clang::BuiltinType::Kind::ULong:
+    case clang::BuiltinType::Kind::LongLong:
+    case clang::BuiltinType::Kind::ULongLong: {
+      result = CreateIntegerLiteral(ast_ctx, val.abs(), type);
+      if (val.isNegative()) {
+        result = CreateUnaryOperator(ast_ctx, clang::UO_Minus, result, type);
+      }
+    } break;
+
+    default:
+      LOG(FATAL) << "Unsupported integer literal type";
+      break;
+  }
   return result;
 }
 
@@ -146,12 +228,28 @@ clang::Expr *IRToASTVisitor::CreateLiteralExpr(llvm::Constant *constant) {
   auto l_type = constant->getType();
   auto c_type = GetQualType(l_type);
 
-  auto CreateInitListLiteral = [this, &constant, &c_type] {
+  auto CreateInitListLiteral = [&] {
     std::vector<clang::Expr *> init_exprs;
-    if (!constant->isZeroValue()) {
-      for (auto i = 0U; auto elm = constant->getAggregateElement(i); ++i) {
-        init_exprs.push_back(GetOperandExpr(elm));
-      }
+    if (constant->isZeroValue()) {
+      return CreateInitListExpr(ast_ctx, init_exprs, c_type);
+    }
+    // Constant data is printed from its buffer, instead of creating a
+    // literal per element
+    if (auto cdata = llvm::dyn_cast<llvm::ConstantDataSequential>(constant)) {
+      auto opaque = CreateOpaqueValueExpr(ast_ctx, c_type);
+      data_inits[opaque] = cdata;
+      return opaque;
+    }
+    std::vector<llvm::Constant *> elms;
+    for (auto i = 0U; auto elm = constant->getAggregateElement(i); ++i) {
+      elms.push_back(elm);
+    }
+    // Elements after the last nonzero one are zero-initialized in C
+    while (!elms.empty() && elms.back()->isNullValue()) {
+      elms.pop_back();
+    }
+    for (auto elm : elms) {
+      init_exprs.push_back(GetOperandExpr(elm));
     }
     return CreateInitListExpr(ast_ctx, init_exprs, c_type);
   };
@@ -167,35 +265,7 @@ clang::Expr *IRToASTVisitor::CreateLiteralExpr(llvm::Constant *constant) {
     // Integers
     case llvm::Type::IntegerTyID: {
       auto val = llvm::cast<llvm::ConstantInt>(constant)->getValue();
-      switch (clang::cast<clang::BuiltinType>(c_type)->getKind()) {
-        case clang::BuiltinType::Kind::UChar:
-        case clang::BuiltinType::Kind::SChar:
-          result = CreateCharacterLiteral(ast_ctx, val, c_type);
-          break;
-
-        case clang::BuiltinType::Kind::Bool:
-          result = CreateIntegerLiteral(ast_ctx, val, ast_ctx.IntTy);
-          break;
-
-        case clang::BuiltinType::Kind::Short:
-        case clang::BuiltinType::Kind::UShort:
-        case clang::BuiltinType::Kind::Int:
-        case clang::BuiltinType::Kind::UInt:
-        case clang::BuiltinType::Kind::Long:
-        case clang::BuiltinType::Kind::ULong:
-        case clang::BuiltinType::Kind::LongLong:
-        case clang::BuiltinType::Kind::ULongLong: {
-          result = CreateIntegerLiteral(ast_ctx, val.abs(), c_type);
-          if (val.isNegative()) {
-            result =
-                CreateUnaryOperator(ast_ctx, clang::UO_Minus, result, c_type);
-          }
-        } break;
-
-        default:
-          LOG(FATAL) << "Unsupported integer literal type";
-          break;
-      }
+      result = CreateIntegerLiteralExpr(val, c_type);
     } break;
 
     case llvm::Type::PointerTyID: {
@@ -210,6 +280,8 @@ clang::Expr *IRToASTVisitor::CreateLiteralExpr(llvm::Constant *constant) {
         std::string init = "";
         if (auto arr = llvm::dyn_cast<llvm::ConstantDataArray>(constant)) {
           init = arr->getAsString();
+          // Trailing NULs are zero-initialized in C
+          init.erase(init.find_last_not_of('\0') + 1);
         }
         result = CreateStringLiteral(ast_ctx, init, c_type);
       } else {
@@ -233,6 +305,51 @@ clang::Expr *IRToASTVisitor::CreateLiteralExpr(llvm::Constant *constant) {
   return result;
 }
 
+bool IRToASTVisitor::IsNameTaken(clang::DeclContext *decl_ctx,
+                                 clang::IdentifierInfo *id) {
+  if (id->getTokenID() != clang::tok::identifier) {
+    return true;
+  }
+  // Parameters are not added to the lookup table of their function
+  if (auto fdecl = clang::dyn_cast<clang::FunctionDecl>(decl_ctx)) {
+    for (auto param : fdecl->parameters()) {
+      if (param->getIdentifier() == id) {
+        return true;
+      }
+    }
+  }
+  for (auto ctx = decl_ctx; ctx; ctx = ctx->getParent()) {
+    if (!ctx->lookup(id).empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string IRToASTVisitor::CreateUniqueName(clang::DeclContext *decl_ctx,
+                                             std::string prefix) {
+  auto &counter = name_counters[decl_ctx][prefix];
+  std::string name;
+  do {
+    name = prefix + std::to_string(counter++);
+  } while (IsNameTaken(decl_ctx, CreateIdentifier(ast_ctx, name)));
+  return name;
+}
+
+std::string IRToASTVisitor::CreateLocalName(clang::FunctionDecl *fdecl,
+                                            std::string name,
+                                            std::string prefix) {
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+    return CreateUniqueName(fdecl, prefix);
+  }
+  // Names that differ in characters that are not valid in identifiers
+  // get the same identifier, so the check is on the identifier
+  if (!IsNameTaken(fdecl, CreateIdentifier(ast_ctx, name))) {
+    return name;
+  }
+  return CreateUniqueName(fdecl, name + "_");
+}
+
 clang::VarDecl *IRToASTVisitor::CreateVarDecl(clang::DeclContext *decl_ctx,
                                               llvm::Type *type,
                                               std::string name) {
@@ -260,10 +377,8 @@ clang::Expr *IRToASTVisitor::GetOperandExpr(llvm::Value *val) {
   if (llvm::isa<llvm::GlobalValue>(val) || llvm::isa<llvm::AllocaInst>(val)) {
     clang::Expr *ref = CreateRef();
     // Add a `&` operator
-    ref = CreateParenExpr(
-        ast_ctx, CreateUnaryOperator(ast_ctx, clang::UO_AddrOf, ref,
-                                     ast_ctx.getPointerType(ref->getType())));
-    return ref;
+    return CreateUnaryOperator(ast_ctx, clang::UO_AddrOf, ref,
+                               ast_ctx.getPointerType(ref->getType()));
   }
   // Operand is a function argument or local variable
   if (llvm::isa<llvm::Argument>(val)) {
@@ -271,8 +386,12 @@ clang::Expr *IRToASTVisitor::GetOperandExpr(llvm::Value *val) {
   }
   // Operand is a result of an expression
   if (llvm::isa<llvm::Instruction>(val)) {
-    return CreateParenExpr(ast_ctx,
-                           clang::cast<clang::Expr>(GetOrCreateStmt(val)));
+    auto expr = clang::cast<clang::Expr>(GetOrCreateStmt(val));
+    // Result is stored in a temporary
+    if (value_decls.count(val)) {
+      return CreateRef();
+    }
+    return expr;
   }
 
   LOG(FATAL) << "Invalid operand";
@@ -305,7 +424,11 @@ clang::Stmt *IRToASTVisitor::GetOrCreateStmt(llvm::Value *val) {
   }
   // Instruction
   if (auto inst = llvm::dyn_cast<llvm::Instruction>(val)) {
+    LowerOperands(inst);
     visit(inst);
+    if (phi_deps.count(inst) || IsTemporary(inst, stmt)) {
+      stmt = CreateTemporary(inst, clang::cast<clang::Expr>(stmt));
+    }
     return stmt;
   }
 
@@ -314,6 +437,224 @@ clang::Stmt *IRToASTVisitor::GetOrCreateStmt(llvm::Value *val) {
   return stmt;
 }
 
+void IRToASTVisitor::LowerOperands(llvm::Instruction *inst) {
+  // Operands that are lowered through `GetOrCreateStmt`
+  auto IsPending = [this](llvm::Value *val) {
+    auto op = llvm::dyn_cast<llvm::Instruction>(val);
+    if (!op || llvm::isa<llvm::AllocaInst>(op)) {
+      return false;
+    }
+    auto it = stmts.find(op);
+    return it == stmts.end() || !it->second;
+  };
+  // Post-order walk of the pending operands. Operands of PHI nodes are
+  // not followed, since they may depend on the PHI node itself.
+  std::vector<std::pair<llvm::Instruction *, bool>> worklist;
+  std::unordered_set<llvm::Instruction *> seen{inst};
+  worklist.emplace_back(inst, false);
+  while (!worklist.empty()) {
+    auto node = worklist.back().first;
+    auto expanded = worklist.back().second;
+    worklist.pop_back();
+    if (expanded) {
+      if (node != inst) {
+        GetOrCreateStmt(node);
+      }
+      continue;
+    }
+    worklist.emplace_back(node, true);
+    if (llvm::isa<llvm::PHINode>(node)) {
+      continue;
+    }
+    for (auto &op : node->operands()) {
+      if (IsPending(op) &&
+          seen.insert(llvm::cast<llvm::Instruction>(op)).second) {
+        worklist.emplace_back(llvm::cast<llvm::Instruction>(op), false);
+      }
+    }
+  }
+}
+
+bool IRToASTVisitor::IsTemporary(llvm::Instruction *inst, clang::Stmt *stmt) {
+  // Instructions of constant expressions have no parent
+  if (!FLAGS_temp_min_uses || !inst->getParent()) {
+    return false;
+  }
+  if (inst->getType()->isVoidTy() || llvm::isa<llvm::AllocaInst>(inst) ||
+      llvm::isa<llvm::PHINode>(inst)) {
+    return false;
+  }
+  if (!inst->hasNUsesOrMore(FLAGS_temp_min_uses)) {
+    return false;
+  }
+  return CountNodes(stmt, FLAGS_temp_min_size) >= FLAGS_temp_min_size;
+}
+
+clang::VarDecl *IRToASTVisitor::CreateLocalVar(llvm::Function *func,
+                                               llvm::Type *type,
+                                               std::string name,
+                                               std::string prefix) {
+  auto fdecl = clang::cast<clang::FunctionDecl>(GetOrCreateDecl(func));
+  name = CreateLocalName(fdecl, name, prefix);
+  // Declare the variable at the start of the function, since its uses
+  // may be in other scopes than its assignments.
+  auto var = CreateVarDecl(fdecl, type, name);
+  fdecl->addDecl(var);
+  temp_decls[func].push_back(CreateDeclStmt(ast_ctx, var));
+  return var;
+}
+
+clang::Expr *IRToASTVisitor::CreateAssign(clang::VarDecl *var,
+                                          clang::Expr *expr) {
+  auto ref = CreateDeclRefExpr(ast_ctx, var);
+  return CreateBinaryOperator(ast_ctx, clang::BO_Assign, ref, expr,
+                              var->getType());
+}
+
+clang::Stmt *IRToASTVisitor::CreateTemporary(llvm::Instruction *inst,
+                                             clang::Expr *expr) {
+  auto var = CreateLocalVar(inst->getFunction(), inst->getType(),
+                            inst->getName().str(), "val");
+  value_decls[inst] = var;
+  // Assign the result where the instruction is
+  return CreateAssign(var, expr);
+}
+
+void IRToASTVisitor::LowerPHINodes(llvm::Function &func) {
+  std::vector<llvm::Instruction *> worklist;
+  for (auto &block : func) {
+    for (auto &inst : block) {
+      if (llvm::isa<llvm::PHINode>(inst)) {
+        GetOrCreateStmt(&inst);
+        worklist.push_back(&inst);
+      }
+    }
+  }
+  // Branches on PHI nodes that the copies of their own block reassign,
+  // typically loop latches that branch on a flag of the loop header, keep
+  // the condition from before the copies
+  for (auto &block : func) {
+    auto br = llvm::dyn_cast<llvm::BranchInst>(block.getTerminator());
+    if (!br || br->isUnconditional()) {
+      continue;
+    }
+    auto phi = llvm::dyn_cast<llvm::PHINode>(br->getCondition());
+    if (!phi) {
+      continue;
+    }
+    for (auto succ : br->successors()) {
+      if (succ == phi->getParent()) {
+        cond_saves[br] = CreateLocalVar(&func, phi->getType(), "", "cond");
+        break;
+      }
+    }
+  }
+  // Whether `inst` is used after the end of its block, where PHI nodes
+  // are reassigned. Branch conditions are used in reaching conditions.
+  auto IsUsedLater = [](llvm::Instruction *inst) {
+    for (auto &use : inst->uses()) {
+      auto user = llvm::cast<llvm::Instruction>(use.getUser());
+      auto block = user->getParent();
+      if (auto phi = llvm::dyn_cast<llvm::PHINode>(user)) {
+        block = phi->getIncomingBlock(use);
+      }
+      if (block != inst->getParent() || llvm::isa<llvm::BranchInst>(user)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  // Results that refer to PHI nodes, directly or through the expressions
+  // of their operands, are stored in variables if they are used later
+  std::unordered_set<llvm::Instruction *> seen;
+  while (!worklist.empty()) {
+    auto inst = worklist.back();
+    worklist.pop_back();
+    for (auto user : inst->users()) {
+      auto dep = llvm::cast<llvm::Instruction>(user);
+      if (llvm::isa<llvm::PHINode>(dep) || dep->getType()->isVoidTy() ||
+          !seen.insert(dep).second) {
+        continue;
+      }
+      if (IsUsedLater(dep)) {
+        phi_deps.insert(dep);
+      } else {
+        worklist.push_back(dep);
+      }
+    }
+  }
+}
+
+std::vector<clang::Stmt *> IRToASTVisitor::CreatePHICopies(
+    llvm::BasicBlock *from, llvm::BasicBlock *to) {
+  std::vector<clang::Stmt *> saves;
+  std::vector<clang::Stmt *> copies;
+  std::unordered_set<clang::VarDecl *> assigned;
+  for (auto &inst : *to) {
+    auto phi = llvm::dyn_cast<llvm::PHINode>(&inst);
+    if (!phi) {
+      break;
+    }
+    auto val = phi->getIncomingValueForBlock(from);
+    if (val == phi || llvm::isa<llvm::UndefValue>(val)) {
+      continue;
+    }
+    GetOrCreateStmt(phi);
+    auto var = clang::cast<clang::VarDecl>(value_decls[phi]);
+    auto expr = GetOperandExpr(val);
+    // The copies of an edge happen in parallel, so values that refer to
+    // variables assigned by earlier copies are saved before any copy.
+    if (RefersTo(expr, assigned)) {
+      auto tmp = CreateLocalVar(from->getParent(), phi->getType(), "", "tmp");
+      saves.push_back(CreateAssign(tmp, expr));
+      expr = CreateDeclRefExpr(ast_ctx, tmp);
+    }
+    copies.push_back(CreateAssign(var, expr));
+    assigned.insert(var);
+  }
+  saves.insert(saves.end(), copies.begin(), copies.end());
+  return saves;
+}
+
+clang::Stmt *IRToASTVisitor::CreateBranchCondSave(llvm::BranchInst *br) {
+  auto it = cond_saves.find(br);
+  if (it == cond_saves.end()) {
+    return nullptr;
+  }
+  return CreateAssign(it->second, GetOrCreateValueExpr(br->getCondition()));
+}
+
+clang::Expr *IRToASTVisitor::GetBranchCondExpr(llvm::BranchInst *br) {
+  auto it = cond_saves.find(br);
+  if (it == cond_saves.end()) {
+    return GetOrCreateValueExpr(br->getCondition());
+  }
+  return CreateDeclRefExpr(ast_ctx, it->second);
+}
+
+clang::Expr *IRToASTVisitor::GetOrCreateValueExpr(llvm::Value *val) {
+  auto expr = clang::cast<clang::Expr>(GetOrCreateStmt(val));
+  auto it = value_decls.find(val);
+  if (llvm::isa<llvm::Instruction>(val) && it != value_decls.end()) {
+    return CreateDeclRefExpr(ast_ctx, it->second);
+  }
+  return expr;
+}
+
+std::vector<clang::Stmt *> IRToASTVisitor::GetTemporaryDecls(
+    llvm::Function &func) {
+  auto it = temp_decls.find(&func);
+  if (it == temp_decls.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+const std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+    &IRToASTVisitor::GetDataInits() {
+  return data_inits;
+}
+
 clang::Decl *IRToASTVisitor::GetOrCreateDecl(llvm::Value *val) {
   auto &decl = value_decls[val];
   if (decl) {
@@ -346,8 +687,7 @@ void IRToASTVisitor::VisitGlobalVar(llvm::GlobalVariable &gvar) {
   auto tudecl = ast_ctx.getTranslationUnitDecl();
   auto name = gvar.getName().str();
   if (name.empty()) {
-    auto num = GetNumDecls<clang::VarDecl>(tudecl);
-    name = "gvar" + std::to_string(num);
+    name = CreateUniqueName(tudecl, "gvar");
   }
   // Create a variable declaration
   var = CreateVarDecl(tudecl, type, name);
@@ -502,8 +842,6 @@ void IRToASTVisitor::visitGetElementPtrInst(llvm::GetElementPtrInst &inst) {
         LOG(FATAL) << "Indexing an unknown pointer type";
         break;
     }
-    // Add parens to preserve expression semantics
-    base = CreateParenExpr(ast_ctx, base);
   }
 
   ref = CreateUnaryOperator(ast_ctx, clang::UO_AddrOf, base,
@@ -523,11 +861,7 @@ void IRToASTVisitor::visitAllocaInst(llvm::AllocaInst &inst) {
   auto &var = value_decls[&inst];
   if (!var) {
     auto fdecl = clang::cast<clang::FunctionDecl>(GetOrCreateDecl(func));
-    auto name = inst.getName().str();
-    if (name.empty()) {
-      auto num = GetNumDecls<clang::VarDecl>(fdecl);
-      name = "var" + std::to_string(num);
-    }
+    auto name = CreateLocalName(fdecl, inst.getName().str(), "var");
 
     var = CreateVarDecl(fdecl, inst.getAllocatedType(), name);
     fdecl->addDecl(var);
@@ -585,6 +919,78 @@ void IRToASTVisitor::visitReturnInst(llvm::ReturnInst &inst) {
   }
 }
 
+clang::Expr *IRToASTVisitor::CreateCastExpr(clang::QualType type,
+                                            clang::CastKind kind,
+                                            clang::Expr *op) {
+  auto src = op->getType();
+  if (ast_ctx.hasSameType(type, src)) {
+    return op;
+  }
+  // Integer casts of integer literals and of other integer casts
+  auto IsInt = [this](clang::QualType t) {
+    return t->isIntegralType(ast_ctx) && !t->isBooleanType();
+  };
+  if (kind == clang::CK_IntegralCast && IsInt(type) && IsInt(src)) {
+    auto width = ast_ctx.getTypeSize(type);
+    auto src_width = ast_ctx.getTypeSize(src);
+    llvm::APInt val;
+    if (IsLiteralType(type) && GetIntegerValue(op, val)) {
+      val = src->isSignedIntegerType() ? val.sextOrTrunc(width)
+                                       : val.zextOrTrunc(width);
+      return CreateIntegerLiteralExpr(val, type);
+    }
+    // `(T2)(T1)x` is `(T2)x` if `T2` is not wider than `T1`, or if `T1`
+    // holds every value of `x`
+    auto inner = clang::dyn_cast<clang::CStyleCastExpr>(op->IgnoreParens());
+    if (inner && inner->getCastKind() == clang::CK_IntegralCast &&
+        IsInt(inner->getSubExpr()->getType())) {
+      auto sub = inner->getSubExpr();
+      auto sub_type = sub->getType();
+      auto sub_width = ast_ctx.getTypeSize(sub_type);
+      if (width <= src_width ||
+          (src_width > sub_width &&
+           (sub_type->isUnsignedIntegerType() || src->isSignedIntegerType()))) {
+        return CreateCastExpr(type, kind, sub);
+      }
+    }
+  }
+  return CreateCStyleCastExpr(ast_ctx, type, kind, op);
+}
+
+bool IRToASTVisitor::IsLiteralType(clang::QualType type) {
+  auto width = ast_ctx.getTypeSize(type);
+  if (width > 64) {
+    return false;
+  }
+  auto lit_type =
+      ast_ctx.getIntTypeForBitwidth(width, type->isSignedIntegerType());
+  return !lit_type.isNull() && ast_ctx.hasSameType(lit_type, type);
+}
+
+bool IRToASTVisitor::GetIntegerValue(clang::Expr *expr, llvm::APInt &val) {
+  expr = expr->IgnoreParens();
+  auto width = ast_ctx.getTypeSize(expr->getType());
+  auto neg = false;
+  if (auto unop = clang::dyn_cast<clang::UnaryOperator>(expr)) {
+    if (unop->getOpcode() != clang::UO_Minus) {
+      return false;
+    }
+    neg = true;
+    expr = unop->getSubExpr()->IgnoreParens();
+  }
+  if (auto lit = clang::dyn_cast<clang::IntegerLiteral>(expr)) {
+    val = lit->getValue().zextOrTrunc(width);
+  } else if (auto chr = clang::dyn_cast<clang::CharacterLiteral>(expr)) {
+    val = llvm::APInt(width, chr->getValue());
+  } else {
+    return false;
+  }
+  if (neg) {
+    val = -val;
+  }
+  return true;
+}
+
 clang::Expr *IRToASTVisitor::CastOperand(clang::QualType dst, clang::Expr *op) {
   // Get operand type
   auto src = op->getType();
@@ -593,7 +999,7 @@ clang::Expr *IRToASTVisitor::CastOperand(clang::QualType dst, clang::Expr *op) {
   auto IsFloat = [](clang::QualType t) { return t->isFloatingType(); };
   auto IsSmaller = ast_ctx.getTypeSize(src) < ast_ctx.getTypeSize(dst);
   auto MakeCast = [this, dst, op](clang::CastKind kind) {
-    return CreateCStyleCastExpr(ast_ctx, dst, kind, op);
+    return CreateCastExpr(dst, kind, op);
   };
 
   // CK_FloatingCast
@@ -638,16 +1044,14 @@ void IRToASTVisitor::visitBinaryOperator(llvm::BinaryOperator &inst) {
     case llvm::BinaryOperator::LShr: {
       auto sign = ast_ctx.getIntTypeForBitwidth(
           ast_ctx.getTypeSize(lhs->getType()), /*signed=*/0);
-      lhs = CreateCStyleCastExpr(ast_ctx, sign,
-                                 clang::CastKind::CK_IntegralCast, lhs);
+      lhs = CreateCastExpr(sign, clang::CastKind::CK_IntegralCast, lhs);
       binop = BinOpExpr(clang::BO_Shr, type);
     } break;
 
     case llvm::BinaryOperator::AShr: {
       auto sign = ast_ctx.getIntTypeForBitwidth(
           ast_ctx.getTypeSize(lhs->getType()), /*signed=*/1);
-      lhs = CreateCStyleCastExpr(ast_ctx, sign,
-                                 clang::CastKind::CK_IntegralCast, lhs);
+      lhs = CreateCastExpr(sign, clang::CastKind::CK_IntegralCast, lhs);
       binop = BinOpExpr(clang::BO_Shr, type);
     } break;
 
@@ -744,7 +1148,7 @@ void IRToASTVisitor::visitCastInst(llvm::CastInst &inst) {
   auto type = GetQualType(inst.getType());
   // Convenience wrapper
   auto CastExpr = [this, &operand, &type](clang::CastKind opc) {
-    return CreateCStyleCastExpr(ast_ctx, type, opc, operand);
+    return CreateCastExpr(type, opc, operand);
   };
   // Create cast
   switch (inst.getOpcode()) {
@@ -800,7 +1204,16 @@ void IRToASTVisitor::visitSelectInst(llvm::SelectInst &inst) {
 
 void IRToASTVisitor::visitPHINode(llvm::PHINode &inst) {
   DLOG(INFO) << "visitPHINode: " << LLVMThingToString(&inst);
-  LOG(FATAL) << "Uninimplemented llvm::PHINode visitor!";
+  auto &ref = stmts[&inst];
+  if (ref) {
+    return;
+  }
+  // PHI nodes are variables that are assigned on the edges into their
+  // block, see `CreatePHICopies`
+  auto var = CreateLocalVar(inst.getFunction(), inst.getType(),
+                            inst.getName().str(), "phi");
+  value_decls[&inst] = var;
+  ref = CreateDeclRefExpr(ast_ctx, var);
 }
 
 }  // namespace rellic
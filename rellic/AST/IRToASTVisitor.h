@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <llvm/IR/Constants.h>
 #include <llvm/IR/InstVisitor.h>
 #include <llvm/IR/Operator.h>
 
@@ -23,7 +24,10 @@
 #include <clang/Frontend/CompilerInstance.h>
 
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace rellic {
 
@@ -32,24 +36,106 @@ class IRToASTVisitor : public llvm::InstVisitor<IRToASTVisitor> {
   clang::ASTContext &ast_ctx;
 
   std::unordered_map<llvm::Type *, clang::TypeDecl *> type_decls;
+  std::unordered_map<llvm::Type *, clang::QualType> types;
   std::unordered_map<llvm::Value *, clang::ValueDecl *> value_decls;
   std::unordered_map<llvm::Value *, clang::Stmt *> stmts;
+  // Next numeric suffix of generated names, per context and prefix
+  std::unordered_map<clang::DeclContext *,
+                     std::unordered_map<std::string, unsigned>>
+      name_counters;
+  // Declarations of the variables of temporaries and PHI nodes, per
+  // function
+  std::unordered_map<llvm::Function *, std::vector<clang::Stmt *>>
+      temp_decls;
+  // Instructions that refer to PHI nodes and are used after the PHI nodes
+  // may have been reassigned
+  std::unordered_set<llvm::Instruction *> phi_deps;
+  // Variables that save branch conditions that are PHI nodes reassigned by
+  // the copies at the end of the block of the branch
+  std::unordered_map<llvm::BranchInst *, clang::VarDecl *> cond_saves;
+  // Constant data that the opaque expressions of initializers stand for
+  std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+      data_inits;
 
   clang::Expr *GetOperandExpr(llvm::Value *val);
   clang::QualType GetQualType(llvm::Type *type);
 
   clang::Expr *CreateLiteralExpr(llvm::Constant *constant);
 
+  // Whether `id` is a keyword, or names a declaration that is visible in
+  // `decl_ctx`
+  bool IsNameTaken(clang::DeclContext *decl_ctx, clang::IdentifierInfo *id);
+  // Returns `prefix` followed by the lowest number that has not been used
+  // with `prefix` in `decl_ctx` yet and does not name a visible declaration
+  std::string CreateUniqueName(clang::DeclContext *decl_ctx,
+                               std::string prefix);
+  // Returns `name` if it can name a new local variable of `fdecl`. Otherwise
+  // returns a unique name that starts with `name`, or with `prefix` if
+  // `name` is empty or not a valid start of an identifier.
+  std::string CreateLocalName(clang::FunctionDecl *fdecl, std::string name,
+                              std::string prefix);
+
   clang::VarDecl *CreateVarDecl(clang::DeclContext *decl_ctx, llvm::Type *type,
                                 std::string name);
 
+  clang::Expr *CreateIntegerLiteralExpr(llvm::APInt val, clang::QualType type);
+  // Creates a cast of `op` to `type`. Casts to the type of `op` are
+  // dropped, integer casts of integer literals are folded into literals
+  // and chains of integer casts are collapsed where that keeps the value.
+  clang::Expr *CreateCastExpr(clang::QualType type, clang::CastKind kind,
+                              clang::Expr *op);
+  // Whether integer literals of `type` can be created
+  bool IsLiteralType(clang::QualType type);
+  // Gets the value of `expr` if it is an integer literal, possibly negated
+  bool GetIntegerValue(clang::Expr *expr, llvm::APInt &val);
   clang::Expr *CastOperand(clang::QualType dst, clang::Expr *op);
 
+  // Lowers the instructions that `inst` transitively depends on, operands
+  // first, so that lowering `inst` does not recurse through them
+  void LowerOperands(llvm::Instruction *inst);
+  // Whether the result of `inst`, whose expression is `stmt`, is stored in
+  // a temporary instead of being repeated at each of its uses
+  bool IsTemporary(llvm::Instruction *inst, clang::Stmt *stmt);
+  // Creates a temporary for the result of `inst` and returns the
+  // assignment of `expr` to it
+  clang::Stmt *CreateTemporary(llvm::Instruction *inst, clang::Expr *expr);
+  // Declares a local variable of `func` named after `name` as given by
+  // `CreateLocalName`
+  clang::VarDecl *CreateLocalVar(llvm::Function *func, llvm::Type *type,
+                                 std::string name, std::string prefix);
+  clang::Expr *CreateAssign(clang::VarDecl *var, clang::Expr *expr);
+
  public:
   IRToASTVisitor(clang::ASTContext &ctx);
 
   clang::Stmt *GetOrCreateStmt(llvm::Value *val);
   clang::Decl *GetOrCreateDecl(llvm::Value *val);
+  // Returns the expression that refers to the value of `val`. Unlike
+  // `GetOrCreateStmt`, this is a reference to the variable of `val` if
+  // the value is stored in one.
+  clang::Expr *GetOrCreateValueExpr(llvm::Value *val);
+  // Returns the declarations of the temporaries and PHI nodes of `func`,
+  // which go at the start of its body
+  std::vector<clang::Stmt *> GetTemporaryDecls(llvm::Function &func);
+  // Returns the constant data of the opaque expressions in initializers,
+  // which is printed straight from its buffer
+  const std::unordered_map<clang::Expr *, llvm::ConstantDataSequential *>
+      &GetDataInits();
+
+  // Declares variables for the PHI nodes of `func`. Has to be called
+  // before the instructions of `func` are lowered.
+  void LowerPHINodes(llvm::Function &func);
+  // Returns the assignments to the PHI nodes of `to` when it is entered
+  // from `from`
+  std::vector<clang::Stmt *> CreatePHICopies(llvm::BasicBlock *from,
+                                             llvm::BasicBlock *to);
+  // Returns the assignment that saves the condition of `br` before the PHI
+  // copies at the end of its block, or `nullptr` if the copies do not
+  // reassign it
+  clang::Stmt *CreateBranchCondSave(llvm::BranchInst *br);
+  // Returns the expression of the condition of `br` as of the end of its
+  // block, after the PHI copies
+  clang::Expr *GetBranchCondExpr(llvm::BranchInst *br);
 
   void VisitGlobalVar(llvm::GlobalVariable &var);
   void VisitFunctionDecl(llvm::Function &func);
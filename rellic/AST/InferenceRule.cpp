@@ -20,16 +20,8 @@ namespace rellic {
 
 clang::Stmt *ApplyFirstMatchingRule(clang::ASTContext &ctx, clang::Stmt *stmt,
                                     std::vector<InferenceRule *> &rules) {
-  clang::ast_matchers::MatchFinder::MatchFinderOptions opts;
-  clang::ast_matchers::MatchFinder finder(opts);
-
-  for (auto rule : rules) {
-    finder.addMatcher(rule->GetCondition(), rule);
-  }
-
-  finder.match(*stmt, ctx);
-
   for (auto rule : rules) {
+    rule->FindMatch(stmt);
     if (*rule) {
       return rule->GetOrCreateSubstitution(ctx, stmt);
     }
@@ -38,4 +30,4 @@ clang::Stmt *ApplyFirstMatchingRule(clang::ASTContext &ctx, clang::Stmt *stmt,
   return stmt;
 }
 
-}  // namespace rellic
\ No newline at end of file
+}  // namespace rellic
@@ -16,26 +16,27 @@
 
 #pragma once
 
-#include <clang/ASTMatchers/ASTMatchFinder.h>
-#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/AST/ASTContext.h>
+
+#include <vector>
+
+#include "rellic/AST/PatternMatch.h"
 
 namespace rellic {
 
-class InferenceRule : public clang::ast_matchers::MatchFinder::MatchCallback {
+class InferenceRule {
  protected:
-  clang::ast_matchers::StatementMatcher cond;
   const clang::Stmt *match;
-  clang::Stmt *substitution;
 
  public:
-  InferenceRule(clang::ast_matchers::StatementMatcher matcher)
-      : cond(matcher), match(nullptr), substitution(nullptr) {}
+  InferenceRule() : match(nullptr) {}
+
+  virtual ~InferenceRule() = default;
 
   operator bool() { return match; }
 
-  const clang::ast_matchers::StatementMatcher &GetCondition() const {
-    return cond;
-  }
+  // Sets `match` to `stmt` if the rule applies to it.
+  virtual void FindMatch(clang::Stmt *stmt) = 0;
 
   virtual clang::Stmt *GetOrCreateSubstitution(clang::ASTContext &ctx,
                                                clang::Stmt *stmt) = 0;
@@ -17,6 +17,8 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <algorithm>
+
 #include "rellic/AST/InferenceRule.h"
 #include "rellic/AST/LoopRefine.h"
 
@@ -24,28 +26,30 @@ namespace rellic {
 
 namespace {
 
-using namespace clang::ast_matchers;
+using namespace rellic::pattern;
 
-// Matches `while(1)`, `if(1)`, etc.
-static const auto cond_true = hasCondition(integerLiteral(equals(true)));
 // Matches `{ break; }`
-static const auto comp_break =
-    compoundStmt(has(breakStmt()), statementCountIs(1));
+static bool IsBreakBlock(clang::Stmt *stmt) {
+  return Matches(stmt, m_And(m_CompoundSize(1), m_HasChild(m_Break())));
+}
+
+// Matches `if (cond) { break; }`
+static bool IsCondBreak(clang::Stmt *stmt) {
+  return Matches(stmt, m_If(m_Any(), m_Pred(IsBreakBlock), m_Any()));
+}
+
+// Matches `while(1)` and binds its compound body
+static bool IsInfiniteLoop(clang::Stmt *stmt, clang::CompoundStmt *&body) {
+  return Matches(stmt, m_While(m_IntLit(1), m_Bind(body)));
+}
 
 class WhileRule : public InferenceRule {
  public:
-  WhileRule()
-      : InferenceRule(whileStmt(
-            stmt().bind("while"), cond_true,
-            hasBody(compoundStmt(
-                has(ifStmt(stmt().bind("if"), hasThen(comp_break))))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    auto loop = result.Nodes.getNodeAs<clang::WhileStmt>("while");
-    auto body = clang::cast<clang::CompoundStmt>(loop->getBody());
-    auto ifstmt = result.Nodes.getNodeAs<clang::IfStmt>("if");
-    if (body->body_front() == ifstmt) {
-      match = loop;
+  void FindMatch(clang::Stmt *stmt) override {
+    clang::CompoundStmt *body;
+    if (IsInfiniteLoop(stmt, body) && !body->body_empty() &&
+        IsCondBreak(body->body_front())) {
+      match = stmt;
     }
   }
 
@@ -68,18 +72,14 @@ class WhileRule : public InferenceRule {
 
 class DoWhileRule : public InferenceRule {
  public:
-  DoWhileRule()
-      : InferenceRule(whileStmt(
-            stmt().bind("while"), cond_true,
-            hasBody(compoundStmt(
-                has(ifStmt(stmt().bind("if"), hasThen(comp_break))))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    auto loop = result.Nodes.getNodeAs<clang::WhileStmt>("while");
-    auto body = clang::cast<clang::CompoundStmt>(loop->getBody());
-    auto ifstmt = result.Nodes.getNodeAs<clang::IfStmt>("if");
-    if (body->body_back() == ifstmt) {
-      match = loop;
+  void FindMatch(clang::Stmt *stmt) override {
+    clang::CompoundStmt *body;
+    if (IsInfiniteLoop(stmt, body)) {
+      auto iter = std::find_if(body->body_begin(), body->body_end(),
+                               IsCondBreak);
+      if (iter != body->body_end() && *iter == body->body_back()) {
+        match = stmt;
+      }
     }
   }
 
@@ -102,27 +102,21 @@ class DoWhileRule : public InferenceRule {
 
 class NestedDoWhileRule : public InferenceRule {
  private:
-  bool matched = false;
+  StmtFacts &facts;
 
  public:
-  NestedDoWhileRule()
-      : InferenceRule(
-            whileStmt(stmt().bind("while"), cond_true,
-                      hasBody(compoundStmt(findAll(ifStmt(
-                          stmt().bind("if"), hasThen(has(breakStmt())))))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    if (!matched) {
-      auto loop = result.Nodes.getNodeAs<clang::WhileStmt>("while");
-      auto body = clang::cast<clang::CompoundStmt>(loop->getBody());
-      auto ifstmt = result.Nodes.getNodeAs<clang::IfStmt>("if");
-      if (body->body_back() == ifstmt) {
-        match = loop;
-      }
-    } else {
-      match = nullptr;
+  NestedDoWhileRule(StmtFacts &facts) : facts(facts) {}
+
+  void FindMatch(clang::Stmt *stmt) override {
+    // The last statement of the body has to be the only `if` in the body
+    // that breaks out of the loop.
+    clang::CompoundStmt *body;
+    if (IsInfiniteLoop(stmt, body) && !body->body_empty() &&
+        facts.CountBreakIfs(body) == 1 &&
+        Matches(body->body_back(),
+                m_If(m_Any(), m_HasChild(m_Break()), m_Any()))) {
+      match = stmt;
     }
-    matched = true;
   }
 
   clang::Stmt *GetOrCreateSubstitution(clang::ASTContext &ctx,
@@ -148,23 +142,20 @@ class NestedDoWhileRule : public InferenceRule {
 
 class LoopToSeq : public InferenceRule {
  public:
-  LoopToSeq()
-      : InferenceRule(
-            whileStmt(stmt().bind("while"), cond_true,
-                      hasBody(compoundStmt(hasAnySubstatement(anyOf(
-                          ifStmt(stmt().bind("if"), hasThen(has(breakStmt())),
-                                 hasElse(has(breakStmt()))),
-                          breakStmt())))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    auto loop = result.Nodes.getNodeAs<clang::WhileStmt>("while");
-    if (auto ifstmt = result.Nodes.getNodeAs<clang::IfStmt>("if")) {
-      auto body = clang::cast<clang::CompoundStmt>(loop->getBody());
-      if (body->body_back() == ifstmt) {
-        match = loop;
+  void FindMatch(clang::Stmt *stmt) override {
+    clang::CompoundStmt *body;
+    if (!IsInfiniteLoop(stmt, body)) {
+      return;
+    }
+    auto if_break = m_If(m_Any(), m_HasChild(m_Break()), m_HasChild(m_Break()));
+    for (auto child : body->body()) {
+      if (Matches(child, if_break)) {
+        match = child == body->body_back() ? stmt : nullptr;
+        return;
+      } else if (Matches(child, m_Break())) {
+        match = stmt;
+        return;
       }
-    } else {
-      match = loop;
     }
   }
 
@@ -195,8 +186,11 @@ class LoopToSeq : public InferenceRule {
         }
         branch = CreateCompoundStmt(ctx, new_branch_body);
       }
-      ifstmt->setThen(branches[0]);
-      ifstmt->setElse(branches[1]);
+      // Build a new `if` instead of editing the old one, since facts about
+      // the old one may be cached.
+      auto new_if = CreateIfStmt(ctx, ifstmt->getCond(), branches[0]);
+      new_if->setElse(branches[1]);
+      new_body.back() = new_if;
     } else {
       new_body.pop_back();
     }
@@ -205,19 +199,20 @@ class LoopToSeq : public InferenceRule {
   }
 };
 
-static const auto has_break = hasDescendant(breakStmt());
-
 class CondToSeqRule : public InferenceRule {
+ private:
+  StmtFacts &facts;
+
  public:
-  CondToSeqRule()
-      : InferenceRule(whileStmt(
-            stmt().bind("while"), cond_true,
-            hasBody(compoundStmt(
-                has(ifStmt(hasThen(unless(has_break)), hasElse(has_break))),
-                statementCountIs(1))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    match = result.Nodes.getNodeAs<clang::WhileStmt>("while");
+  CondToSeqRule(StmtFacts &facts) : facts(facts) {}
+
+  void FindMatch(clang::Stmt *stmt) override {
+    clang::CompoundStmt *body;
+    if (IsInfiniteLoop(stmt, body) && body->size() == 1 &&
+        Matches(body->body_front(), m_If(m_Any(), m_WithoutBreak(facts),
+                                         m_WithBreak(facts)))) {
+      match = stmt;
+    }
   }
 
   clang::Stmt *GetOrCreateSubstitution(clang::ASTContext &ctx,
@@ -244,16 +239,19 @@ class CondToSeqRule : public InferenceRule {
 };
 
 class CondToSeqNegRule : public InferenceRule {
+ private:
+  StmtFacts &facts;
+
  public:
-  CondToSeqNegRule()
-      : InferenceRule(whileStmt(
-            stmt().bind("while"), cond_true,
-            hasBody(compoundStmt(
-                has(ifStmt(hasThen(has_break), hasElse(unless(has_break)))),
-                statementCountIs(1))))) {}
-
-  void run(const MatchFinder::MatchResult &result) {
-    match = result.Nodes.getNodeAs<clang::WhileStmt>("while");
+  CondToSeqNegRule(StmtFacts &facts) : facts(facts) {}
+
+  void FindMatch(clang::Stmt *stmt) override {
+    clang::CompoundStmt *body;
+    if (IsInfiniteLoop(stmt, body) && body->size() == 1 &&
+        Matches(body->body_front(), m_If(m_Any(), m_WithBreak(facts),
+                                         m_WithoutBreak(facts)))) {
+      match = stmt;
+    }
   }
 
   clang::Stmt *GetOrCreateSubstitution(clang::ASTContext &ctx,
@@ -284,28 +282,35 @@ class CondToSeqNegRule : public InferenceRule {
 char LoopRefine::ID = 0;
 
 LoopRefine::LoopRefine(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen)
-    : ModulePass(LoopRefine::ID), ast_ctx(&ctx), ast_gen(&ast_gen) {}
+    : ModulePass(LoopRefine::ID),
+      TransformVisitor<LoopRefine>(ctx),
+      ast_gen(&ast_gen) {}
+
+void LoopRefine::Initialize() {
+  TransformVisitor<LoopRefine>::Initialize();
+  facts.Clear();
+}
 
 bool LoopRefine::VisitWhileStmt(clang::WhileStmt *loop) {
   // DLOG(INFO) << "VisitWhileStmt";
   std::vector<InferenceRule *> rules;
 
-  rules.push_back(new CondToSeqRule);
-  rules.push_back(new CondToSeqNegRule);
-  rules.push_back(new NestedDoWhileRule);
+  rules.push_back(new CondToSeqRule(facts));
+  rules.push_back(new CondToSeqNegRule(facts));
+  rules.push_back(new NestedDoWhileRule(facts));
   rules.push_back(new LoopToSeq);
   rules.push_back(new WhileRule);
   rules.push_back(new DoWhileRule);
 
   auto sub = ApplyFirstMatchingRule(*ast_ctx, loop, rules);
-  if (sub != loop) {
-    substitutions[loop] = sub;
-  }
-
   for (auto rule : rules) {
     delete rule;
   }
 
+  if (sub != loop) {
+    return ReplaceAndVisit(loop, sub);
+  }
+
   return true;
 }
 
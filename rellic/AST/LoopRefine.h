@@ -19,6 +19,7 @@
 #include <llvm/IR/Module.h>
 
 #include "rellic/AST/IRToASTVisitor.h"
+#include "rellic/AST/PatternMatch.h"
 #include "rellic/AST/TransformVisitor.h"
 #include "rellic/AST/Util.h"
 
@@ -27,14 +28,16 @@ namespace rellic {
 class LoopRefine : public llvm::ModulePass,
                    public TransformVisitor<LoopRefine> {
  private:
-  clang::ASTContext *ast_ctx;
   rellic::IRToASTVisitor *ast_gen;
+  StmtFacts facts;
 
  public:
   static char ID;
 
   LoopRefine(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen);
 
+  void Initialize();
+
   bool VisitWhileStmt(clang::WhileStmt *loop);
 
   bool runOnModule(llvm::Module &module) override;
@@ -20,6 +20,7 @@
 #include "rellic/AST/NestedCondProp.h"
 #include "rellic/AST/Util.h"
 #include "rellic/AST/Z3ConvVisitor.h"
+#include "rellic/AST/Z3QueryLog.h"
 
 namespace rellic {
 
@@ -42,11 +43,27 @@ char NestedCondProp::ID = 0;
 NestedCondProp::NestedCondProp(clang::ASTContext &ctx,
                                rellic::IRToASTVisitor &ast_gen)
     : ModulePass(NestedCondProp::ID),
-      ast_ctx(&ctx),
+      TransformVisitor<NestedCondProp>(ctx),
       ast_gen(&ast_gen),
       z3_ctx(new z3::context()),
       z3_gen(new rellic::Z3ConvVisitor(ast_ctx, z3_ctx.get())) {}
 
+void NestedCondProp::ResetZ3Context() {
+  // Release the converter before the context it refers to
+  z3_gen.reset();
+  z3_ctx.reset(new z3::context());
+  z3_gen.reset(new rellic::Z3ConvVisitor(ast_ctx, z3_ctx.get()));
+}
+
+bool NestedCondProp::VisitFunctionDecl(clang::FunctionDecl *fdecl) {
+  // Traversal is in post-order, so the body has been refined at this point
+  // and this drops the expressions of the current function
+  if (z3_gen->FinishFunction()) {
+    ResetZ3Context();
+  }
+  return TransformVisitor<NestedCondProp>::VisitFunctionDecl(fdecl);
+}
+
 bool NestedCondProp::VisitIfStmt(clang::IfStmt *ifstmt) {
   // DLOG(INFO) << "VisitIfStmt";
   // Determine whether `cond` is a constant expression
@@ -83,7 +100,10 @@ bool NestedCondProp::VisitIfStmt(clang::IfStmt *ifstmt) {
     z3::expr_vector dst(*z3_ctx);
     src.push_back(parent_expr);
     dst.push_back(z3_ctx->bool_val(true));
-    auto sub = child_expr.substitute(src, dst).simplify();
+    Z3QueryTimer timer;
+    auto goal = child_expr.substitute(src, dst);
+    auto sub = goal.simplify();
+    timer.Finish(goal, "simplify", GetState().function, ifstmt);
     if (!z3::eq(child_expr, sub)) {
       ifstmt->setCond(z3_gen->GetOrCreateCExpr(sub));
       changed = true;
@@ -31,11 +31,12 @@ namespace rellic {
 class NestedCondProp : public llvm::ModulePass,
                        public TransformVisitor<NestedCondProp> {
  private:
-  clang::ASTContext *ast_ctx;
   rellic::IRToASTVisitor *ast_gen;
   std::unique_ptr<z3::context> z3_ctx;
   std::unique_ptr<rellic::Z3ConvVisitor> z3_gen;
 
+  void ResetZ3Context();
+
   std::unordered_map<clang::IfStmt *, clang::Expr *> parent_conds;
 
  public:
@@ -45,6 +46,7 @@ class NestedCondProp : public llvm::ModulePass,
 
   NestedCondProp(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen);
 
+  bool VisitFunctionDecl(clang::FunctionDecl *fdecl);
   bool VisitIfStmt(clang::IfStmt *stmt);
 
   bool runOnModule(llvm::Module &module) override;
@@ -27,7 +27,7 @@ char NestedScopeCombiner::ID = 0;
 NestedScopeCombiner::NestedScopeCombiner(clang::ASTContext &ctx,
                                          rellic::IRToASTVisitor &ast_gen)
     : ModulePass(NestedScopeCombiner::ID),
-      ast_ctx(&ctx),
+      TransformVisitor<NestedScopeCombiner>(ctx),
       ast_gen(&ast_gen) {}
 
 bool NestedScopeCombiner::VisitIfStmt(clang::IfStmt *ifstmt) {
@@ -37,28 +37,18 @@ bool NestedScopeCombiner::VisitIfStmt(clang::IfStmt *ifstmt) {
   llvm::APSInt val;
   bool is_const = ifstmt->getCond()->isIntegerConstantExpr(val, *ast_ctx);
   if (is_const && val.getBoolValue()) {
-    substitutions[ifstmt] = ifstmt->getThen();
+    ReplaceStmt(ifstmt, ifstmt->getThen());
   }
   return true;
 }
 
 bool NestedScopeCombiner::VisitCompoundStmt(clang::CompoundStmt *compound) {
   // DLOG(INFO) << "VisitCompoundStmt";
-  bool has_compound = false;
-  std::vector<clang::Stmt *> new_body;
   for (auto stmt : compound->body()) {
-    if (auto child = clang::dyn_cast<clang::CompoundStmt>(stmt)) {
-      new_body.insert(new_body.end(), child->body_begin(), child->body_end());
-      has_compound = true;
-    } else {
-      new_body.push_back(stmt);
+    if (auto child = clang::dyn_cast_or_null<clang::CompoundStmt>(stmt)) {
+      SpliceCompound(child);
     }
   }
-  
-  if (has_compound) {
-    substitutions[compound] = CreateCompoundStmt(*ast_ctx, new_body);
-  }
-  
   return true;
 }
 
@@ -27,7 +27,6 @@ namespace rellic {
 class NestedScopeCombiner : public llvm::ModulePass,
                             public TransformVisitor<NestedScopeCombiner> {
  private:
-  clang::ASTContext *ast_ctx;
   rellic::IRToASTVisitor *ast_gen;
 
  public:
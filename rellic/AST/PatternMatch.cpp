@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "rellic/AST/PatternMatch.h"
+
+namespace rellic {
+
+StmtFacts::Facts StmtFacts::Get(clang::Stmt *stmt) {
+  auto iter = cache.find(stmt);
+  if (iter != cache.end()) {
+    return iter->second;
+  }
+
+  Facts facts = {false, 0};
+  for (auto child : stmt->children()) {
+    if (child) {
+      auto sub = Get(child);
+      facts.has_break |= sub.has_break || clang::isa<clang::BreakStmt>(child);
+      facts.num_break_ifs += sub.num_break_ifs;
+    }
+  }
+
+  if (auto ifstmt = clang::dyn_cast<clang::IfStmt>(stmt)) {
+    auto then = ifstmt->getThen();
+    auto children = then->children();
+    if (std::any_of(children.begin(), children.end(), [](clang::Stmt *child) {
+          return child && clang::isa<clang::BreakStmt>(child);
+        })) {
+      ++facts.num_break_ifs;
+    }
+  }
+
+  facts.num_break_ifs = std::min(facts.num_break_ifs, 2U);
+  cache[stmt] = facts;
+  return facts;
+}
+
+}  // namespace rellic
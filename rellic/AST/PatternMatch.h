@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <llvm/ADT/DenseMap.h>
+
+#include <clang/AST/Expr.h>
+#include <clang/AST/Stmt.h>
+
+namespace rellic {
+
+// Structural facts about statements that the inference rules check. Facts
+// are computed once per statement, so checking them is O(1) after the
+// first query. Statements must not be modified in place after their facts
+// have been queried.
+class StmtFacts {
+ private:
+  struct Facts {
+    bool has_break;
+    unsigned num_break_ifs;
+  };
+
+  llvm::DenseMap<clang::Stmt *, Facts> cache;
+
+  Facts Get(clang::Stmt *stmt);
+
+ public:
+  // Whether a descendant of `stmt` is a `break`
+  bool HasBreak(clang::Stmt *stmt) { return Get(stmt).has_break; }
+  // Number of `if`s in `stmt`, including `stmt`, whose then-branch has a
+  // `break` child. Saturates at 2.
+  unsigned CountBreakIfs(clang::Stmt *stmt) {
+    return Get(stmt).num_break_ifs;
+  }
+
+  void Clear() { cache.clear(); }
+};
+
+// Composable matchers for statement shapes, in the style of LLVM's
+// `PatternMatch`. Patterns are plain objects, so they are checked without
+// any dynamic matcher machinery. Patterns other than `m_Any` do not match
+// `nullptr`.
+namespace pattern {
+
+template <typename Pattern>
+bool Matches(clang::Stmt *stmt, const Pattern &pattern) {
+  return pattern.match(stmt);
+}
+
+struct AnyMatch {
+  bool match(clang::Stmt *stmt) const { return true; }
+};
+
+// Matches any statement, including `nullptr`
+inline AnyMatch m_Any() { return AnyMatch(); }
+
+template <typename T>
+struct ClassMatch {
+  bool match(clang::Stmt *stmt) const { return stmt && clang::isa<T>(stmt); }
+};
+
+// Matches a statement of class `T`
+template <typename T>
+ClassMatch<T> m_Class() {
+  return ClassMatch<T>();
+}
+
+inline ClassMatch<clang::BreakStmt> m_Break() {
+  return ClassMatch<clang::BreakStmt>();
+}
+
+template <typename T>
+struct BindMatch {
+  T *&bound;
+
+  bool match(clang::Stmt *stmt) const {
+    if (auto node = clang::dyn_cast_or_null<T>(stmt)) {
+      bound = node;
+      return true;
+    }
+    return false;
+  }
+};
+
+// Matches a statement of class `T` and binds it to `bound`
+template <typename T>
+BindMatch<T> m_Bind(T *&bound) {
+  return BindMatch<T>{bound};
+}
+
+struct PredMatch {
+  bool (*pred)(clang::Stmt *);
+
+  bool match(clang::Stmt *stmt) const { return stmt && pred(stmt); }
+};
+
+// Matches a statement for which `pred` holds
+inline PredMatch m_Pred(bool (*pred)(clang::Stmt *)) {
+  return PredMatch{pred};
+}
+
+template <typename LHS, typename RHS>
+struct AndMatch {
+  LHS lhs;
+  RHS rhs;
+
+  bool match(clang::Stmt *stmt) const {
+    return lhs.match(stmt) && rhs.match(stmt);
+  }
+};
+
+template <typename LHS, typename RHS>
+AndMatch<LHS, RHS> m_And(const LHS &lhs, const RHS &rhs) {
+  return AndMatch<LHS, RHS>{lhs, rhs};
+}
+
+struct BreakMatch {
+  StmtFacts &facts;
+  bool has_break;
+
+  bool match(clang::Stmt *stmt) const {
+    return stmt && facts.HasBreak(stmt) == has_break;
+  }
+};
+
+// Matches a statement that has a `break` descendant
+inline BreakMatch m_WithBreak(StmtFacts &facts) {
+  return BreakMatch{facts, true};
+}
+
+// Matches a statement without `break` descendants
+inline BreakMatch m_WithoutBreak(StmtFacts &facts) {
+  return BreakMatch{facts, false};
+}
+
+struct IntLitMatch {
+  uint64_t value;
+
+  bool match(clang::Stmt *stmt) const {
+    auto lit = clang::dyn_cast_or_null<clang::IntegerLiteral>(stmt);
+    return lit && lit->getValue() == value;
+  }
+};
+
+// Matches an integer literal of value `value`
+inline IntLitMatch m_IntLit(uint64_t value) { return IntLitMatch{value}; }
+
+struct CompoundSizeMatch {
+  unsigned size;
+
+  bool match(clang::Stmt *stmt) const {
+    auto comp = clang::dyn_cast_or_null<clang::CompoundStmt>(stmt);
+    return comp && comp->size() == size;
+  }
+};
+
+// Matches a compound statement of `size` statements
+inline CompoundSizeMatch m_CompoundSize(unsigned size) {
+  return CompoundSizeMatch{size};
+}
+
+template <typename Child>
+struct HasChildMatch {
+  Child child;
+
+  bool match(clang::Stmt *stmt) const {
+    if (!stmt) {
+      return false;
+    }
+    for (auto sub : stmt->children()) {
+      if (child.match(sub)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// Matches a statement with a child that matches `child`. Children are tried
+// in order up to the first one that matches.
+template <typename Child>
+HasChildMatch<Child> m_HasChild(const Child &child) {
+  return HasChildMatch<Child>{child};
+}
+
+template <typename Cond, typename Body>
+struct WhileMatch {
+  Cond cond;
+  Body body;
+
+  bool match(clang::Stmt *stmt) const {
+    auto loop = clang::dyn_cast_or_null<clang::WhileStmt>(stmt);
+    return loop && cond.match(loop->getCond()) && body.match(loop->getBody());
+  }
+};
+
+template <typename Cond, typename Body>
+WhileMatch<Cond, Body> m_While(const Cond &cond, const Body &body) {
+  return WhileMatch<Cond, Body>{cond, body};
+}
+
+template <typename Cond, typename Then, typename Else>
+struct IfMatch {
+  Cond cond;
+  Then then;
+  Else els;
+
+  bool match(clang::Stmt *stmt) const {
+    auto ifstmt = clang::dyn_cast_or_null<clang::IfStmt>(stmt);
+    return ifstmt && cond.match(ifstmt->getCond()) &&
+           then.match(ifstmt->getThen()) && els.match(ifstmt->getElse());
+  }
+};
+
+template <typename Cond, typename Then, typename Else>
+IfMatch<Cond, Then, Else> m_If(const Cond &cond, const Then &then,
+                               const Else &els) {
+  return IfMatch<Cond, Then, Else>{cond, then, els};
+}
+
+template <typename Sub>
+struct UnOpMatch {
+  clang::UnaryOperatorKind opc;
+  Sub sub;
+
+  bool match(clang::Stmt *stmt) const {
+    auto op = clang::dyn_cast_or_null<clang::UnaryOperator>(stmt);
+    return op && op->getOpcode() == opc && sub.match(op->getSubExpr());
+  }
+};
+
+template <typename Sub>
+UnOpMatch<Sub> m_UnOp(clang::UnaryOperatorKind opc, const Sub &sub) {
+  return UnOpMatch<Sub>{opc, sub};
+}
+
+struct ComparisonMatch {
+  bool match(clang::Stmt *stmt) const {
+    auto binop = clang::dyn_cast_or_null<clang::BinaryOperator>(stmt);
+    return binop && binop->isComparisonOp();
+  }
+};
+
+// Matches a comparison operator
+inline ComparisonMatch m_Comparison() { return ComparisonMatch(); }
+
+template <typename Sub>
+struct ParenMatch {
+  Sub sub;
+
+  bool match(clang::Stmt *stmt) const {
+    auto paren = clang::dyn_cast_or_null<clang::ParenExpr>(stmt);
+    return paren && sub.match(paren->getSubExpr());
+  }
+};
+
+template <typename Sub>
+ParenMatch<Sub> m_Paren(const Sub &sub) {
+  return ParenMatch<Sub>{sub};
+}
+
+template <typename Base, typename Idx>
+struct ArraySubscriptMatch {
+  Base base;
+  Idx idx;
+
+  bool match(clang::Stmt *stmt) const {
+    auto sub = clang::dyn_cast_or_null<clang::ArraySubscriptExpr>(stmt);
+    return sub && base.match(sub->getBase()) && idx.match(sub->getIdx());
+  }
+};
+
+template <typename Base, typename Idx>
+ArraySubscriptMatch<Base, Idx> m_ArraySubscript(const Base &base,
+                                                const Idx &idx) {
+  return ArraySubscriptMatch<Base, Idx>{base, idx};
+}
+
+template <typename Base>
+struct ArrowMatch {
+  Base base;
+
+  bool match(clang::Stmt *stmt) const {
+    auto member = clang::dyn_cast_or_null<clang::MemberExpr>(stmt);
+    return member && member->isArrow() && base.match(member->getBase());
+  }
+};
+
+// Matches `base->field`
+template <typename Base>
+ArrowMatch<Base> m_Arrow(const Base &base) {
+  return ArrowMatch<Base>{base};
+}
+
+struct VarRefMatch {
+  bool match(clang::Stmt *stmt) const {
+    auto ref = clang::dyn_cast_or_null<clang::DeclRefExpr>(stmt);
+    return ref && clang::isa<clang::VarDecl>(ref->getDecl());
+  }
+};
+
+// Matches a reference to a variable
+inline VarRefMatch m_VarRef() { return VarRefMatch(); }
+
+template <typename Sub>
+struct IgnoreParenImpCastsMatch {
+  Sub sub;
+
+  bool match(clang::Stmt *stmt) const {
+    auto expr = clang::dyn_cast_or_null<clang::Expr>(stmt);
+    return expr && sub.match(expr->IgnoreParenImpCasts());
+  }
+};
+
+template <typename Sub>
+IgnoreParenImpCastsMatch<Sub> m_IgnoreParenImpCasts(const Sub &sub) {
+  return IgnoreParenImpCastsMatch<Sub>{sub};
+}
+
+template <typename Sub>
+struct IgnoreImpCastsMatch {
+  Sub sub;
+
+  bool match(clang::Stmt *stmt) const {
+    auto expr = clang::dyn_cast_or_null<clang::Expr>(stmt);
+    return expr && sub.match(expr->IgnoreImpCasts());
+  }
+};
+
+template <typename Sub>
+IgnoreImpCastsMatch<Sub> m_IgnoreImpCasts(const Sub &sub) {
+  return IgnoreImpCastsMatch<Sub>{sub};
+}
+
+}  // namespace pattern
+
+}  // namespace rellic
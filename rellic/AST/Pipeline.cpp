@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <llvm/ADT/FoldingSet.h>
+#include <llvm/IR/LegacyPassManager.h>
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "rellic/AST/CondBasedRefine.h"
+#include "rellic/AST/DeadStmtElim.h"
+#include "rellic/AST/ExprCombine.h"
+#include "rellic/AST/FusedTransform.h"
+#include "rellic/AST/GenerateAST.h"
+#include "rellic/AST/LoopRefine.h"
+#include "rellic/AST/NestedCondProp.h"
+#include "rellic/AST/NestedScopeCombiner.h"
+#include "rellic/AST/Pipeline.h"
+#include "rellic/AST/Util.h"
+#include "rellic/AST/Z3CondSimplify.h"
+
+#include "rellic/BC/Compat/Transforms.h"
+
+namespace rellic {
+
+namespace {
+
+static const std::unordered_map<std::string, std::string> presets = {
+    // Cheap triage: capped refinement and no final Z3 simplification
+    {"fast",
+     "ast: dse;"
+     "cbr*4: z3cs[simplify], ncp, nsc, cbr;"
+     "loop*4: lr+nsc;"
+     "fin: nsc+ec"},
+    // The regular pipeline
+    {"default",
+     "ast: dse;"
+     "cbr*: z3cs[aig+simplify], ncp, nsc, cbr;"
+     "loop*: lr+nsc;"
+     "fin: z3cs[aig+propagate-bv-bounds+tseitin-cnf+ctx-simplify], ncp,"
+     "     nsc+ec"},
+    // Contextual simplification during refinement and a final fixed point
+    {"thorough",
+     "ast: dse;"
+     "cbr*: z3cs[aig+ctx-simplify+simplify], ncp, nsc, cbr;"
+     "loop*: lr+nsc;"
+     "fin*: z3cs[aig+propagate-bv-bounds+tseitin-cnf+ctx-simplify], ncp,"
+     "      nsc+ec"},
+};
+
+// Removes whitespace and `#` comments
+static std::string Normalize(const std::string &desc) {
+  std::string result;
+  bool comment = false;
+  for (auto chr : desc) {
+    if (chr == '#') {
+      comment = true;
+    } else if (chr == '\n') {
+      comment = false;
+    } else if (!comment && !std::isspace(static_cast<unsigned char>(chr))) {
+      result.push_back(chr);
+    }
+  }
+  return result;
+}
+
+static PassDesc ParsePass(const std::string &str) {
+  PassDesc result;
+  auto lbr = str.find('[');
+  result.name = str.substr(0, lbr);
+  if (lbr != std::string::npos) {
+    CHECK(str.back() == ']') << "Unterminated tactic chain in pass: " << str;
+    result.tactics = Split(str.substr(lbr + 1, str.size() - lbr - 2), '+');
+  }
+  static const std::vector<std::string> names(
+      {"dse", "z3cs", "ncp", "nsc", "cbr", "lr", "ec", "dse+nsc", "nsc+ec",
+       "dse+nsc+ec", "lr+nsc"});
+  CHECK(std::find(names.begin(), names.end(), result.name) != names.end())
+      << "Unknown pass in pipeline: " << result.name;
+  CHECK(result.tactics.empty() || result.name == "z3cs")
+      << "Pass " << result.name << " does not take a tactic chain";
+  return result;
+}
+
+static PassGroupDesc ParseGroup(const std::string &str) {
+  PassGroupDesc result;
+  auto colon = str.find(':');
+  CHECK(colon != std::string::npos) << "Missing ':' in pass group: " << str;
+  auto head = str.substr(0, colon);
+  auto star = head.find('*');
+  result.name = head.substr(0, star);
+  result.fixpoint = star != std::string::npos;
+  result.max_iters = 0;
+  result.explicit_cap = result.fixpoint && star + 1 < head.size();
+  if (result.explicit_cap) {
+    auto count = head.substr(star + 1);
+    auto valid = std::all_of(count.begin(), count.end(), ::isdigit);
+    if (valid) {
+      try {
+        auto value = std::stoul(count);
+        valid = value <= std::numeric_limits<unsigned>::max();
+        result.max_iters = value;
+      } catch (std::out_of_range &e) {
+        valid = false;
+      }
+    }
+    CHECK(valid) << "Invalid iteration count in pass group: " << head;
+  }
+  for (auto &pass : Split(str.substr(colon + 1), ',')) {
+    result.passes.push_back(ParsePass(pass));
+  }
+  CHECK(!result.passes.empty()) << "Empty pass group: " << result.name;
+  return result;
+}
+
+static llvm::ModulePass *CreatePass(const PassDesc &pass,
+                                    clang::ASTContext &ast_ctx,
+                                    rellic::IRToASTVisitor &gen) {
+  if (pass.name == "dse") {
+    return createDeadStmtElimPass(ast_ctx, gen);
+  } else if (pass.name == "ncp") {
+    return createNestedCondPropPass(ast_ctx, gen);
+  } else if (pass.name == "nsc") {
+    return createNestedScopeCombinerPass(ast_ctx, gen);
+  } else if (pass.name == "cbr") {
+    return createCondBasedRefinePass(ast_ctx, gen);
+  } else if (pass.name == "lr") {
+    return createLoopRefinePass(ast_ctx, gen);
+  } else if (pass.name == "ec") {
+    return createExprCombinePass(ast_ctx, gen);
+  } else if (pass.name == "dse+nsc") {
+    return createFusedTransformPass<DeadStmtElim, NestedScopeCombiner>(
+        ast_ctx, gen);
+  } else if (pass.name == "nsc+ec") {
+    return createFusedTransformPass<NestedScopeCombiner, ExprCombine>(ast_ctx,
+                                                                      gen);
+  } else if (pass.name == "dse+nsc+ec") {
+    return createFusedTransformPass<DeadStmtElim, NestedScopeCombiner,
+                                    ExprCombine>(ast_ctx, gen);
+  } else if (pass.name == "lr+nsc") {
+    return createFusedTransformPass<LoopRefine, NestedScopeCombiner>(ast_ctx,
+                                                                     gen);
+  }
+
+  CHECK(pass.name == "z3cs") << "Unknown pass in pipeline: " << pass.name;
+  auto simplifier = new rellic::Z3CondSimplify(ast_ctx, gen);
+  if (!pass.tactics.empty()) {
+    try {
+      simplifier->SetZ3Tactics(pass.tactics);
+    } catch (z3::exception &e) {
+      LOG(FATAL) << "Invalid Z3 tactic chain: " << e.msg();
+    }
+  }
+  return simplifier;
+}
+
+// Profiles of the function bodies in the translation unit. Full profiles
+// are kept instead of their hashes, so that a hash collision is not taken
+// for a revisited state.
+using Fingerprint =
+    std::vector<std::pair<clang::FunctionDecl *, llvm::FoldingSetNodeID>>;
+
+static Fingerprint GetFingerprint(clang::ASTContext &ast_ctx) {
+  Fingerprint result;
+  for (auto decl : ast_ctx.getTranslationUnitDecl()->decls()) {
+    auto fdecl = clang::dyn_cast<clang::FunctionDecl>(decl);
+    if (fdecl && fdecl->doesThisDeclarationHaveABody()) {
+      llvm::FoldingSetNodeID id;
+      fdecl->getBody()->Profile(id, ast_ctx, /*Canonical=*/true);
+      result.push_back({fdecl, id});
+    }
+  }
+  return result;
+}
+
+// Runs `group` until it reaches a fixed point, every function that it
+// changes revisits an earlier state of its own, or it exceeds its
+// iteration cap. A function that revisits a state oscillates, while the
+// others may still converge.
+static void RunFixpointGroup(PassGroupDesc &group, llvm::Module &module,
+                             clang::ASTContext &ast_ctx,
+                             rellic::IRToASTVisitor &gen) {
+  // One pass manager per pass, so that we know which passes make changes
+  std::vector<std::unique_ptr<llvm::legacy::PassManager>> pms;
+  for (auto &pass : group.passes) {
+    pms.emplace_back(new llvm::legacy::PassManager);
+    pms.back()->add(CreatePass(pass, ast_ctx, gen));
+  }
+
+  // States of each function
+  std::unordered_map<clang::FunctionDecl *,
+                     std::vector<llvm::FoldingSetNodeID>>
+      seen;
+  std::unordered_set<clang::FunctionDecl *> oscillating;
+  auto prev = GetFingerprint(ast_ctx);
+  for (auto &func : prev) {
+    seen[func.first].push_back(func.second);
+  }
+
+  for (auto iter = 1U;; ++iter) {
+    std::vector<std::string> changed;
+    for (auto i = 0U; i < pms.size(); ++i) {
+      if (pms[i]->run(module)) {
+        changed.push_back(group.passes[i].name);
+      }
+    }
+
+    if (changed.empty()) {
+      break;
+    }
+
+    auto curr = GetFingerprint(ast_ctx);
+    auto any_changed = false;
+    auto converging = false;
+    for (auto i = 0U; i < curr.size(); ++i) {
+      auto fdecl = curr[i].first;
+      auto &state = curr[i].second;
+      if (state == prev[i].second) {
+        continue;
+      }
+      any_changed = true;
+      auto &states = seen[fdecl];
+      if (std::find(states.begin(), states.end(), state) == states.end()) {
+        states.push_back(state);
+        converging = true;
+      } else if (oscillating.insert(fdecl).second) {
+        LOG(WARNING) << "Function " << fdecl->getNameAsString()
+                     << " oscillates under pass group " << group.name
+                     << " in round " << iter
+                     << "; changed by passes: " << Join(changed, ", ");
+      }
+    }
+
+    if (!any_changed) {
+      // Rewrites that rebuild statements without changing them
+      LOG(INFO) << "Pass group " << group.name << " reached a fixed point in "
+                << "round " << iter << "; passes reported changes without "
+                << "effect: " << Join(changed, ", ");
+      break;
+    }
+
+    if (!converging) {
+      LOG(WARNING) << "Pass group " << group.name
+                   << " only changes oscillating functions in round "
+                   << iter;
+      break;
+    }
+
+    if (iter == group.max_iters) {
+      LOG(WARNING) << "Pass group " << group.name
+                   << " did not reach a fixed point in " << iter
+                   << " rounds; last changed by passes: "
+                   << Join(changed, ", ");
+      break;
+    }
+
+    prev = curr;
+  }
+}
+
+static llvm::Pass *CreateIRPass(const std::string &name) {
+  if (name == "simplifycfg") {
+    return llvm::createCFGSimplificationPass();
+  } else if (name == "early-cse") {
+    return llvm::createEarlyCSEPass();
+  } else if (name == "instcombine") {
+    return llvm::createInstructionCombiningPass();
+  }
+
+  CHECK(name == "dce") << "Unknown pass in IR pipeline: " << name;
+  return llvm::createDeadCodeEliminationPass();
+}
+
+}  // namespace
+
+std::string GetPipelinePreset(std::string name) {
+  auto iter = presets.find(name);
+  return iter == presets.end() ? "" : iter->second;
+}
+
+PipelineDesc ParsePipeline(std::string desc) {
+  PipelineDesc result;
+  for (auto &group : Split(Normalize(desc), ';')) {
+    result.push_back(ParseGroup(group));
+  }
+  return result;
+}
+
+std::vector<std::string> ParseIRPipeline(std::string desc) {
+  auto result = Split(Normalize(desc), ',');
+  static const std::vector<std::string> names(
+      {"simplifycfg", "early-cse", "instcombine", "dce"});
+  for (auto &name : result) {
+    CHECK(std::find(names.begin(), names.end(), name) != names.end())
+        << "Unknown pass in IR pipeline: " << name;
+  }
+  return result;
+}
+
+void RunIRPipeline(const std::vector<std::string> &passes,
+                   llvm::Module &module) {
+  if (passes.empty()) {
+    return;
+  }
+  LOG(INFO) << "Running IR passes: " << Join(passes, ", ");
+  llvm::legacy::PassManager pm;
+  for (auto &name : passes) {
+    pm.add(CreateIRPass(name));
+  }
+  // CFG simplification turns chains of comparisons into `switch`es
+  pm.add(llvm::createLowerSwitchPass());
+  pm.run(module);
+}
+
+void RunPipeline(PipelineDesc &pipeline, llvm::Module &module,
+                 clang::ASTContext &ast_ctx, rellic::IRToASTVisitor &gen) {
+  llvm::legacy::PassManager ast;
+  ast.add(rellic::createGenerateASTPass(ast_ctx, gen));
+  ast.run(module);
+
+  for (auto &group : pipeline) {
+    LOG(INFO) << "Running pass group " << group.name;
+    if (group.fixpoint) {
+      RunFixpointGroup(group, module, ast_ctx, gen);
+      continue;
+    }
+
+    llvm::legacy::PassManager pm;
+    for (auto &pass : group.passes) {
+      pm.add(CreatePass(pass, ast_ctx, gen));
+    }
+    pm.run(module);
+  }
+}
+
+}  // namespace rellic
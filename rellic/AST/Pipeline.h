@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <llvm/IR/Module.h>
+
+#include <string>
+#include <vector>
+
+#include "rellic/AST/IRToASTVisitor.h"
+
+namespace rellic {
+
+// A refinement pass of a pipeline. `tactics` is the Z3 tactic chain
+// used by condition simplification passes.
+struct PassDesc {
+  std::string name;
+  std::vector<std::string> tactics;
+};
+
+// A group of passes that runs once or, if `fixpoint` is set, until none
+// of its passes changes the AST. A fixed-point group also stops when every
+// function that it changes returns to a state of its own seen in an
+// earlier round, which means its passes undo each other there.
+// `max_iters` caps the number of rounds of a fixed-point group; 0 means no
+// cap. `explicit_cap` is set if the cap was given in the description, and
+// is not to be replaced by a default.
+struct PassGroupDesc {
+  std::string name;
+  bool fixpoint;
+  bool explicit_cap;
+  unsigned max_iters;
+  std::vector<PassDesc> passes;
+};
+
+using PipelineDesc = std::vector<PassGroupDesc>;
+
+// Returns the description of the preset pipeline `name`, or an empty
+// string if there is no such preset.
+std::string GetPipelinePreset(std::string name);
+
+// Parses a pipeline description. Groups are separated by `;` and have
+// the form `name[*[N]]:pass,pass,...`. A `*` makes the group run to a
+// fixed point, at most `N` rounds if given, where `*0` means no cap.
+// Condition simplification passes take a Z3 tactic chain, e.g.
+// `z3cs[aig+simplify]`. Whitespace and `#` comments are ignored.
+//
+// Passes:
+//   dse   dead statement elimination
+//   z3cs  Z3 condition simplification
+//   ncp   nested condition propagation
+//   nsc   nested scope combination
+//   cbr   condition-based refinement
+//   lr    loop refinement
+//   ec    expression combination
+//
+// Some local passes can be fused into a single traversal of the AST by
+// joining them with `+`: `dse+nsc`, `nsc+ec`, `dse+nsc+ec` and `lr+nsc`.
+PipelineDesc ParsePipeline(std::string desc);
+
+// Parses a comma-separated list of LLVM passes that simplify the module
+// before its AST is generated. Whitespace is ignored.
+//
+// Passes:
+//   simplifycfg  CFG simplification
+//   early-cse    early common subexpression elimination
+//   instcombine  instruction combining
+//   dce          dead code elimination
+std::vector<std::string> ParseIRPipeline(std::string desc);
+
+// Runs the LLVM passes `passes` on `module`, followed by a pass that
+// turns the `switch` instructions they may introduce back into branches.
+void RunIRPipeline(const std::vector<std::string> &passes,
+                   llvm::Module &module);
+
+// Generates the AST of `module` and refines it by running `pipeline`.
+void RunPipeline(PipelineDesc &pipeline, llvm::Module &module,
+                 clang::ASTContext &ast_ctx, rellic::IRToASTVisitor &gen);
+
+}  // namespace rellic
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <glog/logging.h>
+
+#include "rellic/AST/Precedence.h"
+
+namespace rellic {
+
+namespace {
+
+enum Precedence : unsigned {
+  kComma = 1,
+  kAssign,
+  kConditional,
+  kLOr,
+  kLAnd,
+  kOr,
+  kXor,
+  kAnd,
+  kEquality,
+  kRelational,
+  kShift,
+  kAdditive,
+  kMultiplicative,
+  kPtrMem,
+  kUnary,
+  kPostfix,
+  kPrimary
+};
+
+static unsigned GetBinOpPrecedence(clang::BinaryOperatorKind opc) {
+  if (clang::BinaryOperator::isAssignmentOp(opc)) {
+    return kAssign;
+  }
+  switch (opc) {
+    case clang::BO_PtrMemD:
+    case clang::BO_PtrMemI:
+      return kPtrMem;
+    case clang::BO_Mul:
+    case clang::BO_Div:
+    case clang::BO_Rem:
+      return kMultiplicative;
+    case clang::BO_Add:
+    case clang::BO_Sub:
+      return kAdditive;
+    case clang::BO_Shl:
+    case clang::BO_Shr:
+      return kShift;
+    case clang::BO_LT:
+    case clang::BO_GT:
+    case clang::BO_LE:
+    case clang::BO_GE:
+      return kRelational;
+    case clang::BO_EQ:
+    case clang::BO_NE:
+      return kEquality;
+    case clang::BO_And:
+      return kAnd;
+    case clang::BO_Xor:
+      return kXor;
+    case clang::BO_Or:
+      return kOr;
+    case clang::BO_LAnd:
+      return kLAnd;
+    case clang::BO_LOr:
+      return kLOr;
+    case clang::BO_Comma:
+      return kComma;
+    default:
+      LOG(FATAL) << "Unknown binary operator: "
+                 << clang::BinaryOperator::getOpcodeStr(opc).str();
+      return kComma;
+  }
+}
+
+}  // namespace
+
+unsigned GetPrecedence(clang::Expr *expr) {
+  expr = expr->IgnoreImpCasts();
+  if (auto binop = clang::dyn_cast<clang::BinaryOperator>(expr)) {
+    return GetBinOpPrecedence(binop->getOpcode());
+  }
+  if (clang::isa<clang::AbstractConditionalOperator>(expr)) {
+    return kConditional;
+  }
+  if (auto unop = clang::dyn_cast<clang::UnaryOperator>(expr)) {
+    return unop->isPostfix() ? kPostfix : kUnary;
+  }
+  if (clang::isa<clang::CastExpr>(expr) ||
+      clang::isa<clang::UnaryExprOrTypeTraitExpr>(expr)) {
+    return kUnary;
+  }
+  if (clang::isa<clang::ArraySubscriptExpr>(expr) ||
+      clang::isa<clang::CallExpr>(expr) ||
+      clang::isa<clang::MemberExpr>(expr) ||
+      clang::isa<clang::CompoundLiteralExpr>(expr)) {
+    return kPostfix;
+  }
+  return kPrimary;
+}
+
+bool NeedsParens(clang::Stmt *parent, unsigned index, clang::Expr *child) {
+  auto prec = GetPrecedence(child);
+  if (prec == kPrimary) {
+    return false;
+  }
+  auto inner = child->IgnoreImpCasts();
+  if (auto unop = clang::dyn_cast<clang::UnaryOperator>(parent)) {
+    if (unop->isPostfix()) {
+      return prec < kPostfix;
+    }
+    // `-(-a)` would be printed as `--a`
+    auto sub = clang::dyn_cast<clang::UnaryOperator>(inner);
+    if (sub && (unop->getOpcode() == clang::UO_Minus ||
+                unop->getOpcode() == clang::UO_Plus)) {
+      switch (sub->getOpcode()) {
+        case clang::UO_Minus:
+        case clang::UO_Plus:
+        case clang::UO_PreDec:
+        case clang::UO_PreInc:
+          return true;
+        default:
+          break;
+      }
+    }
+    return prec < kUnary;
+  }
+  if (clang::isa<clang::CastExpr>(parent) ||
+      clang::isa<clang::UnaryExprOrTypeTraitExpr>(parent)) {
+    // Implicit casts are not printed
+    return !clang::isa<clang::ImplicitCastExpr>(parent) && prec < kUnary;
+  }
+  if (clang::isa<clang::ArraySubscriptExpr>(parent) ||
+      clang::isa<clang::CallExpr>(parent)) {
+    // The base or callee, then the index or arguments
+    return index == 0 ? prec < kPostfix : prec <= kComma;
+  }
+  if (clang::isa<clang::MemberExpr>(parent)) {
+    return prec < kPostfix;
+  }
+  if (clang::isa<clang::AbstractConditionalOperator>(parent)) {
+    // The condition, the true and the false expression
+    switch (index) {
+      case 0:
+        return prec <= kConditional;
+      case 1:
+        return prec <= kComma;
+      default:
+        return prec < kConditional;
+    }
+  }
+  if (auto binop = clang::dyn_cast<clang::BinaryOperator>(parent)) {
+    auto opc = binop->getOpcode();
+    if (binop->isAssignmentOp()) {
+      return index == 0 ? prec < kUnary : prec < kAssign;
+    }
+    auto child_binop = clang::dyn_cast<clang::BinaryOperator>(inner);
+    if (child_binop && child_binop->getOpcode() != opc) {
+      if (binop->isBitwiseOp() || binop->isShiftOp()) {
+        return true;
+      }
+      if (opc == clang::BO_LOr && child_binop->getOpcode() == clang::BO_LAnd) {
+        return true;
+      }
+    }
+    if (child_binop && child_binop->getOpcode() == opc &&
+        (opc == clang::BO_LAnd || opc == clang::BO_LOr)) {
+      // `a && (b && c)` evaluates the same as `a && b && c`
+      return false;
+    }
+    auto parent_prec = GetBinOpPrecedence(opc);
+    // Binary operators other than assignments are left-associative
+    return index == 0 ? prec < parent_prec : prec <= parent_prec;
+  }
+  return clang::isa<clang::InitListExpr>(parent) && prec <= kComma;
+}
+
+}  // namespace rellic
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Expr.h>
+
+namespace rellic {
+
+// Expressions are built without `ParenExpr`s, since the AST already
+// determines how they group. Parentheses are only needed when they are
+// printed, where C precedence would otherwise group them differently.
+
+// Returns the C precedence level of `expr`. Higher levels bind tighter.
+unsigned GetPrecedence(clang::Expr *expr);
+
+// Whether `child`, the `index`-th child of `parent`, has to be
+// parenthesized when it is printed. Besides the cases that C precedence
+// requires, this parenthesizes operands that compilers warn about, like
+// arithmetic in bitwise operators and `&&` in `||`. Right operands of
+// `&&` and `||` with the same operator are not parenthesized, since those
+// operators are associative.
+bool NeedsParens(clang::Stmt *parent, unsigned index, clang::Expr *child);
+
+}  // namespace rellic
@@ -16,43 +16,219 @@
 
 #pragma once
 
+#include <glog/logging.h>
+
+#include <llvm/ADT/SmallPtrSet.h>
+
 #include <clang/AST/RecursiveASTVisitor.h>
 
+#include <vector>
+
 #include "rellic/AST/Util.h"
 
 namespace rellic {
 
+// Runs the `Visit*` methods of `visitor` that apply to the dynamic class
+// of `stmt`, the same way a traversal would.
+template <typename Visitor>
+bool WalkUpFromAnyStmt(Visitor &visitor, clang::Stmt *stmt) {
+  switch (stmt->getStmtClass()) {
+#define ABSTRACT_STMT(STMT)
+#define STMT(CLASS, PARENT)      \
+  case clang::Stmt::CLASS##Class: \
+    return visitor.WalkUpFrom##CLASS(static_cast<clang::CLASS *>(stmt));
+#include <clang/AST/StmtNodes.inc>
+    default:
+      return true;
+  }
+}
+
+// Editing state of a traversal. Passes that are fused into one traversal
+// share a single state.
+struct TransformState {
+  // Parent map of the statement that is currently visited; the back of
+  // the vector is the parent of `visited`.
+  std::vector<clang::Stmt *> parents;
+  clang::Stmt *visited = nullptr;
+  // The visited statement before any replacement, and its parent. The
+  // replacements of `origin` take its place in `origin_parent`.
+  clang::Stmt *origin = nullptr;
+  clang::Stmt *origin_parent = nullptr;
+  // Compounds with `nullptr` or spliced children
+  llvm::SmallPtrSet<clang::CompoundStmt *, 8> dirty;
+  // Compounds whose bodies get inlined into their parent compound
+  llvm::SmallPtrSet<clang::CompoundStmt *, 8> spliced;
+  // Substitutions for statements without a parent statement
+  StmtMap root_subs;
+  // Function whose body is traversed
+  clang::FunctionDecl *function = nullptr;
+};
+
+// Base of the AST refinement passes. Statements are edited in place through
+// `ReplaceStmt`, `EraseStmt` and `SpliceCompound` while the AST is traversed
+// in post-order. The parent of every edited statement is known from the
+// traversal, so no per-child substitution lookups are needed. Compounds that
+// contain erased or spliced statements are rebuilt once, when their parent is
+// visited.
 template <typename Derived>
 class TransformVisitor : public clang::RecursiveASTVisitor<Derived> {
+ private:
+  TransformState own_state;
+  TransformState *state;
+
+  clang::Stmt *GetParent(clang::Stmt *stmt) {
+    if (stmt == state->visited || stmt == state->origin) {
+      return state->origin_parent;
+    }
+    // Not the visited statement, so it has to be one of its children
+    return state->visited;
+  }
+
+  void ExpandBody(clang::CompoundStmt *compound,
+                  std::vector<clang::Stmt *> &body) {
+    for (auto stmt : compound->body()) {
+      auto child = clang::dyn_cast_or_null<clang::CompoundStmt>(stmt);
+      if (child && state->spliced.count(child)) {
+        // `child` is not in the AST anymore after this
+        state->spliced.erase(child);
+        state->dirty.erase(child);
+        ExpandBody(child, body);
+      } else if (stmt) {
+        body.push_back(stmt);
+      }
+    }
+  }
+
+  clang::CompoundStmt *RebuildCompound(clang::CompoundStmt *compound) {
+    state->dirty.erase(compound);
+    std::vector<clang::Stmt *> body;
+    ExpandBody(compound, body);
+    return CreateCompoundStmt(*ast_ctx, body);
+  }
+
  protected:
-  StmtMap substitutions;
+  clang::ASTContext *ast_ctx;
   bool changed;
 
+  // Replaces `stmt` with `sub` in its parent. `stmt` has to be either
+  // the visited statement or one of its children. Replacing the visited
+  // statement after it has been replaced replaces its latest replacement.
+  void ReplaceStmt(clang::Stmt *stmt, clang::Stmt *sub) {
+    if (stmt == state->origin) {
+      stmt = state->visited;
+    }
+    if (auto parent = GetParent(stmt)) {
+      CHECK(ReplaceChild(parent, stmt, sub))
+          << "Replaced statement is not a child of its parent!";
+    } else {
+      state->root_subs[state->origin] = sub;
+    }
+    if (stmt == state->visited) {
+      state->visited = sub;
+    }
+    changed = true;
+  }
+
+  // Replaces the visited statement `stmt` with `sub` and visits `sub` in
+  // its place, so that rules are applied to a local fixed point instead of
+  // once per traversal.
+  bool ReplaceAndVisit(clang::Stmt *stmt, clang::Stmt *sub) {
+    CHECK(stmt == state->visited) << "Revisited statement is not visited!";
+    ReplaceStmt(stmt, sub);
+    return WalkUpFromAnyStmt(static_cast<Derived &>(*this), sub);
+  }
+
+  // Removes `stmt` from its parent compound.
+  void EraseStmt(clang::Stmt *stmt) {
+    auto parent = GetParent(stmt);
+    if (auto compound = clang::dyn_cast_or_null<clang::CompoundStmt>(parent)) {
+      ReplaceStmt(stmt, nullptr);
+      state->dirty.insert(compound);
+    } else {
+      std::vector<clang::Stmt *> empty;
+      ReplaceStmt(stmt, CreateCompoundStmt(*ast_ctx, empty));
+    }
+  }
+
+  // Inlines the body of `compound` into its parent compound.
+  void SpliceCompound(clang::CompoundStmt *compound) {
+    auto parent = GetParent(compound);
+    if (auto comp = clang::dyn_cast_or_null<clang::CompoundStmt>(parent)) {
+      state->spliced.insert(compound);
+      state->dirty.insert(comp);
+      changed = true;
+    }
+  }
+
  public:
-  TransformVisitor() : changed(false) {}
+  TransformVisitor(clang::ASTContext &ctx)
+      : state(&own_state), ast_ctx(&ctx), changed(false) {}
 
   virtual bool shouldTraversePostOrder() { return true; }
 
   void Initialize() {
     changed = false;
-    substitutions.clear();
+    *state = TransformState();
+  }
+
+  bool IsChanged() { return changed; }
+
+  TransformState &GetState() { return *state; }
+  // Makes this visitor edit the AST through the state of another one.
+  void SetState(TransformState &other) { state = &other; }
+
+  bool TraverseFunctionDecl(clang::FunctionDecl *fdecl) {
+    state->function = fdecl;
+    return clang::RecursiveASTVisitor<Derived>::TraverseFunctionDecl(fdecl);
+  }
+
+  bool dataTraverseStmtPre(clang::Stmt *stmt) {
+    state->parents.push_back(stmt);
+    return true;
+  }
+
+  bool dataTraverseStmtPost(clang::Stmt *stmt) {
+    auto &parents = state->parents;
+    parents.pop_back();
+    state->visited = stmt;
+    state->origin = stmt;
+    state->origin_parent = parents.empty() ? nullptr : parents.back();
+    return true;
   }
 
   bool VisitFunctionDecl(clang::FunctionDecl *fdecl) {
     // DLOG(INFO) << "VisitFunctionDecl";
-    if (auto body = fdecl->getBody()) {
-      auto iter = substitutions.find(body);
-      if (iter != substitutions.end()) {
-        fdecl->setBody(iter->second);
-        changed = true;
-      }
+    if (!fdecl->doesThisDeclarationHaveABody()) {
+      return true;
+    }
+    auto body = fdecl->getBody();
+    auto iter = state->root_subs.find(body);
+    if (iter != state->root_subs.end()) {
+      body = iter->second;
+      fdecl->setBody(body);
+    }
+    auto compound = clang::dyn_cast_or_null<clang::CompoundStmt>(body);
+    if (compound && state->dirty.count(compound)) {
+      fdecl->setBody(RebuildCompound(compound));
     }
     return true;
   }
 
   bool VisitStmt(clang::Stmt *stmt) {
     // DLOG(INFO) << "VisitStmt";
-    changed |= ReplaceChildren(stmt, substitutions);
+    auto &dirty = state->dirty;
+    if (dirty.empty()) {
+      return true;
+    }
+    // Rebuild child compounds that have erased or spliced statements.
+    // Spliced compounds are expanded as part of their parent instead.
+    for (auto &child : stmt->children()) {
+      auto compound = clang::dyn_cast_or_null<clang::CompoundStmt>(child);
+      if (compound && dirty.count(compound) &&
+          !state->spliced.count(compound)) {
+        child = RebuildCompound(compound);
+      }
+    }
     return true;
   }
 };
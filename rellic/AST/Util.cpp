@@ -19,6 +19,8 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <sstream>
+
 #include "rellic/AST/Compat/Expr.h"
 #include "rellic/AST/Compat/Stmt.h"
 #include "rellic/AST/Util.h"
@@ -55,16 +57,14 @@ void InitCompilerInstance(clang::CompilerInstance &ins,
   ins.createASTContext();
 }
 
-bool ReplaceChildren(clang::Stmt *stmt, StmtMap &repl_map) {
-  auto change = false;
-  for (auto c_it = stmt->child_begin(); c_it != stmt->child_end(); ++c_it) {
-    auto s_it = repl_map.find(*c_it);
-    if (s_it != repl_map.end()) {
-      *c_it = s_it->second;
-      change = true;
+bool ReplaceChild(clang::Stmt *parent, clang::Stmt *child, clang::Stmt *sub) {
+  for (auto &c_stmt : parent->children()) {
+    if (c_stmt == child) {
+      c_stmt = sub;
+      return true;
     }
   }
-  return change;
+  return false;
 }
 
 clang::IdentifierInfo *CreateIdentifier(clang::ASTContext &ctx,
@@ -95,15 +95,9 @@ clang::BreakStmt *CreateBreakStmt(clang::ASTContext &ctx) {
   return new (ctx) clang::BreakStmt(clang::SourceLocation());
 }
 
-clang::ParenExpr *CreateParenExpr(clang::ASTContext &ctx, clang::Expr *expr) {
-  return new (ctx)
-      clang::ParenExpr(clang::SourceLocation(), clang::SourceLocation(), expr);
-}
-
 clang::Expr *CreateNotExpr(clang::ASTContext &ctx, clang::Expr *op) {
   CHECK(op) << "No operand given for unary logical expression";
-  return CreateUnaryOperator(ctx, clang::UO_LNot, CreateParenExpr(ctx, op),
-                             ctx.BoolTy);
+  return CreateUnaryOperator(ctx, clang::UO_LNot, op, ctx.BoolTy);
 }
 
 clang::Expr *CreateAndExpr(clang::ASTContext &ctx, clang::Expr *lhs,
@@ -224,6 +218,12 @@ clang::Expr *CreateNullPointerExpr(clang::ASTContext &ctx) {
                               clang::CastKind::CK_NullToPointer, zero);
 }
 
+clang::Expr *CreateOpaqueValueExpr(clang::ASTContext &ctx,
+                                   clang::QualType type) {
+  return new (ctx)
+      clang::OpaqueValueExpr(clang::SourceLocation(), type, clang::VK_RValue);
+}
+
 clang::Stmt *CreateDeclStmt(clang::ASTContext &ctx, clang::Decl *decl) {
   return new (ctx)
       clang::DeclStmt(clang::DeclGroupRef(decl), clang::SourceLocation(),
@@ -246,4 +246,28 @@ clang::Expr *CreateConditionalOperatorExpr(clang::ASTContext &ctx,
       clang::VK_RValue, clang::OK_Ordinary);
 }
 
+std::vector<std::string> Split(const std::string &str, char delim) {
+  std::vector<std::string> result;
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, delim)) {
+    if (!item.empty()) {
+      result.push_back(item);
+    }
+  }
+  return result;
+}
+
+std::string Join(const std::vector<std::string> &strs,
+                 const std::string &delim) {
+  std::string result;
+  for (auto &str : strs) {
+    if (!result.empty()) {
+      result += delim;
+    }
+    result += str;
+  }
+  return result;
+}
+
 }  // namespace rellic
@@ -20,7 +20,9 @@
 #include <clang/Basic/TargetInfo.h>
 #include <clang/Frontend/CompilerInstance.h>
 
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "rellic/AST/Compat/Expr.h"
 #include "rellic/AST/Compat/Stmt.h"
@@ -36,7 +38,7 @@ using StmtMap = std::unordered_map<clang::Stmt *, clang::Stmt *>;
 void InitCompilerInstance(clang::CompilerInstance &ins,
                           std::string target_triple);
 
-bool ReplaceChildren(clang::Stmt *stmt, StmtMap &repl_map);
+bool ReplaceChild(clang::Stmt *parent, clang::Stmt *child, clang::Stmt *sub);
 
 clang::IdentifierInfo *CreateIdentifier(clang::ASTContext &ctx,
                                         std::string name);
@@ -52,8 +54,6 @@ clang::BreakStmt *CreateBreakStmt(clang::ASTContext &ctx);
 clang::DeclRefExpr *CreateDeclRefExpr(clang::ASTContext &ctx,
                                       clang::ValueDecl *val);
 
-clang::ParenExpr *CreateParenExpr(clang::ASTContext &ctx, clang::Expr *expr);
-
 clang::Expr *CreateNotExpr(clang::ASTContext &ctx, clang::Expr *op);
 
 clang::Expr *CreateAndExpr(clang::ASTContext &ctx, clang::Expr *lhs,
@@ -109,6 +109,9 @@ clang::Expr *CreateMemberExpr(clang::ASTContext &ctx, clang::Expr *base,
 
 clang::Expr *CreateNullPointerExpr(clang::ASTContext &ctx);
 
+clang::Expr *CreateOpaqueValueExpr(clang::ASTContext &ctx,
+                                   clang::QualType type);
+
 clang::Expr *CreateCStyleCastExpr(clang::ASTContext &ctx, clang::QualType type,
                                   clang::CastKind cast, clang::Expr *op);
 
@@ -123,4 +126,11 @@ clang::Expr *CreateConditionalOperatorExpr(clang::ASTContext &ctx,
                                            clang::Expr *rhs,
                                            clang::QualType type);
 
+// Splits `str` at every `delim`, dropping empty items
+std::vector<std::string> Split(const std::string &str, char delim);
+
+// Joins `strs` with `delim` between them
+std::string Join(const std::vector<std::string> &strs,
+                 const std::string &delim);
+
 }  // namespace rellic
\ No newline at end of file
@@ -17,50 +17,494 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <llvm/ADT/FoldingSet.h>
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+#include "rellic/AST/Util.h"
 #include "rellic/AST/Z3CondSimplify.h"
+#include "rellic/AST/Z3QueryLog.h"
+#include "rellic/AST/Z3Util.h"
+
+DEFINE_bool(native_cond_simplify, true,
+            "Simplify conditions whose atoms are independent of each other "
+            "without Z3.");
+DEFINE_bool(z3_abstract_atoms, false,
+            "Abstract calls, loads, member accesses and pointer casts in "
+            "conditions to fresh variables before simplifying them with Z3.");
+DEFINE_bool(z3_opaque_fp, false,
+            "Treat floating-point values and comparisons in conditions as "
+            "opaque instead of modeling IEEE semantics in Z3.");
+
+DEFINE_bool(z3_adaptive_tactics, true,
+            "Choose the Z3 tactics for a condition by its size: skip trivial "
+            "conditions and use contextual tactics only for conditions with "
+            "several atoms.");
+
+DEFINE_string(z3_portfolio, "",
+              "Z3 tactic chains to race against the configured chain on "
+              "expensive conditions, each in its own thread. Chains are "
+              "separated by ',' and their tactics by '+', e.g. "
+              "\"aig+simplify,ctx-simplify+simplify\".");
+
+DEFINE_uint32(z3_jobs, 1,
+              "Number of threads that simplify the conditions of a function "
+              "with Z3 concurrently. Can not be combined with "
+              "--z3_portfolio.");
 
 namespace rellic {
 
+namespace {
+
+// Tactics whose cost grows with the size and context of the goal
+static const char *kExpensiveTactics[] = {
+    "ctx-simplify", "ctx-solver-simplify", "propagate-bv-bounds",
+    "tseitin-cnf"};
+
+// Beyond these bounds contextual simplification rarely finishes quickly
+static const unsigned kMaxContextualNodes = 4096;
+static const unsigned kMaxContextualDepth = 256;
+
+static bool IsExpensiveTactic(const std::string &name) {
+  return std::find(std::begin(kExpensiveTactics), std::end(kExpensiveTactics),
+                   name) != std::end(kExpensiveTactics);
+}
+
+static void SetCond(clang::Stmt *stmt, clang::Expr *cond) {
+  if (auto ifstmt = clang::dyn_cast<clang::IfStmt>(stmt)) {
+    ifstmt->setCond(cond);
+  } else if (auto loop = clang::dyn_cast<clang::WhileStmt>(stmt)) {
+    loop->setCond(cond);
+  } else {
+    clang::cast<clang::DoStmt>(stmt)->setCond(cond);
+  }
+}
+
+struct CondCost {
+  // Nodes of the condition
+  unsigned nodes = 0;
+  // `!`, `&&` and `||` operators
+  unsigned ops = 0;
+  // Structurally distinct operands of the logical operators
+  unsigned atoms = 0;
+  // Nesting depth of the logical operators
+  unsigned depth = 0;
+};
+
+static unsigned CountNodes(clang::Stmt *stmt) {
+  unsigned count = 0;
+  std::vector<clang::Stmt *> work{stmt};
+  while (!work.empty()) {
+    auto node = work.back();
+    work.pop_back();
+    ++count;
+    for (auto child : node->children()) {
+      if (child) {
+        work.push_back(child);
+      }
+    }
+  }
+  return count;
+}
+
+// Measures `cond` without recursion, since conditions of long if-ladders
+// are deeply nested.
+static CondCost EstimateCost(clang::ASTContext &ctx, clang::Expr *cond) {
+  CondCost cost;
+  std::unordered_set<unsigned> atoms;
+  std::vector<std::pair<clang::Expr *, unsigned>> work{{cond, 0}};
+  while (!work.empty()) {
+    auto expr = work.back().first;
+    auto depth = work.back().second;
+    work.pop_back();
+    cost.depth = std::max(cost.depth, depth);
+    if (auto paren = clang::dyn_cast<clang::ParenExpr>(expr)) {
+      ++cost.nodes;
+      work.emplace_back(paren->getSubExpr(), depth);
+      continue;
+    }
+    auto unop = clang::dyn_cast<clang::UnaryOperator>(expr);
+    if (unop && unop->getOpcode() == clang::UO_LNot) {
+      ++cost.nodes;
+      ++cost.ops;
+      work.emplace_back(unop->getSubExpr(), depth + 1);
+      continue;
+    }
+    auto binop = clang::dyn_cast<clang::BinaryOperator>(expr);
+    if (binop && binop->isLogicalOp()) {
+      ++cost.nodes;
+      ++cost.ops;
+      work.emplace_back(binop->getLHS(), depth + 1);
+      work.emplace_back(binop->getRHS(), depth + 1);
+      continue;
+    }
+    cost.nodes += CountNodes(expr);
+    llvm::FoldingSetNodeID id;
+    expr->Profile(id, ctx, /*Canonical=*/true);
+    atoms.insert(id.ComputeHash());
+  }
+  cost.atoms = atoms.size();
+  return cost;
+}
+
+}  // namespace
+
 char Z3CondSimplify::ID = 0;
 
 Z3CondSimplify::Z3CondSimplify(clang::ASTContext &ctx,
                                rellic::IRToASTVisitor &ast_gen)
     : ModulePass(Z3CondSimplify::ID),
-      ast_ctx(&ctx),
+      TransformVisitor<Z3CondSimplify>(ctx),
       ast_gen(&ast_gen),
       z3_ctx(new z3::context()),
       z3_gen(new rellic::Z3ConvVisitor(ast_ctx, z3_ctx.get())),
-      z3_simplifier(*z3_ctx, "simplify") {}
+      bool_simplifier(ctx),
+      z3_simplifier(*z3_ctx, "simplify"),
+      z3_cheap_simplifier(*z3_ctx, "simplify"),
+      z3_tactic_names({"simplify"}),
+      z3_cheap_tactic_names({"simplify"}) {
+  z3_gen->SetAbstractAtoms(FLAGS_z3_abstract_atoms);
+  z3_gen->SetOpaqueFloatingPoint(FLAGS_z3_opaque_fp);
+}
+
+void Z3CondSimplify::SetZ3Tactics(const std::vector<std::string> &tactics) {
+  std::vector<std::string> cheap;
+  for (auto &name : tactics) {
+    if (!IsExpensiveTactic(name)) {
+      cheap.push_back(name);
+    }
+  }
+  if (cheap.empty()) {
+    cheap.push_back("simplify");
+  }
+  z3_simplifier = CreateTacticChain(*z3_ctx, tactics);
+  z3_cheap_simplifier = CreateTacticChain(*z3_ctx, cheap);
+  z3_tactic_names = tactics;
+  z3_cheap_tactic_names = cheap;
+}
 
-clang::Expr *Z3CondSimplify::SimplifyCExpr(clang::Expr *c_expr) {
+// Replaces the context and everything that refers to it. Tactics and the
+// converter are released before the old context.
+void Z3CondSimplify::ResetZ3Context() {
+  std::unique_ptr<z3::context> ctx(new z3::context());
+  z3_simplifier = CreateTacticChain(*ctx, z3_tactic_names);
+  z3_cheap_simplifier = CreateTacticChain(*ctx, z3_cheap_tactic_names);
+  z3_gen.reset(new rellic::Z3ConvVisitor(ast_ctx, ctx.get()));
+  z3_gen->SetAbstractAtoms(FLAGS_z3_abstract_atoms);
+  z3_gen->SetOpaqueFloatingPoint(FLAGS_z3_opaque_fp);
+  z3_ctx = std::move(ctx);
+}
+
+void Z3CondSimplify::InitWorkers() {
+  workers.clear();
+  if (FLAGS_z3_jobs < 2) {
+    return;
+  }
+  // Workers only apply the configured chains
+  LOG_IF(FATAL, !FLAGS_z3_portfolio.empty())
+      << "--z3_portfolio can not be combined with --z3_jobs greater than 1";
+  for (auto i = 0U; i < FLAGS_z3_jobs; ++i) {
+    std::unique_ptr<z3::context> ctx(new z3::context());
+    auto simplifier = CreateTacticChain(*ctx, z3_tactic_names);
+    auto cheap_simplifier = CreateTacticChain(*ctx, z3_cheap_tactic_names);
+    workers.push_back({std::move(ctx), simplifier, cheap_simplifier});
+  }
+}
+
+// Simplifies the queued conditions on the workers and sets the results.
+// Queries are assigned up front, heaviest first to the least loaded
+// worker, because goals have to be translated into the worker contexts on
+// this thread.
+void Z3CondSimplify::RunQueries() {
+  if (queries.empty()) {
+    return;
+  }
+  std::vector<unsigned> order(queries.size());
+  std::iota(order.begin(), order.end(), 0U);
+  std::stable_sort(order.begin(), order.end(), [this](unsigned a, unsigned b) {
+    return queries[a].weight > queries[b].weight;
+  });
+  auto num_workers = workers.size();
+  std::vector<std::vector<unsigned>> assigned(num_workers);
+  std::vector<uint64_t> load(num_workers, 0);
+  std::vector<z3::expr_vector> inputs;
+  std::vector<z3::expr_vector> outputs;
+  for (auto &worker : workers) {
+    inputs.emplace_back(*worker.ctx);
+    outputs.emplace_back(*worker.ctx);
+  }
+  for (auto id : order) {
+    auto w = std::min_element(load.begin(), load.end()) - load.begin();
+    auto &ctx = *workers[w].ctx;
+    auto z3_expr = queries[id].z3_expr;
+    assigned[w].push_back(id);
+    load[w] += queries[id].weight;
+    inputs[w].push_back(z3::to_expr(ctx, Z3_translate(*z3_ctx, z3_expr, ctx)));
+  }
+
+  auto func = GetState().function;
+  auto tactics = Join(z3_tactic_names, "+");
+  auto cheap_tactics = Join(z3_cheap_tactic_names, "+");
+  std::vector<std::thread> threads;
+  for (auto w = 0U; w < num_workers; ++w) {
+    threads.emplace_back([&, w] {
+      auto &worker = workers[w];
+      for (auto i = 0U; i < assigned[w].size(); ++i) {
+        auto &query = queries[assigned[w][i]];
+        auto &tactic =
+            query.expensive ? worker.simplifier : worker.cheap_simplifier;
+        try {
+          Z3QueryTimer timer;
+          z3::goal goal(*worker.ctx);
+          goal.add(inputs[w][i]);
+          auto app = tactic(goal);
+          CHECK(app.size() == 1)
+              << "Unexpected multiple goals in application!";
+          outputs[w].push_back(app[0].as_expr().simplify());
+          timer.Finish(inputs[w][i],
+                       query.expensive ? tactics : cheap_tactics, func,
+                       query.stmt);
+        } catch (z3::exception &e) {
+          LOG(FATAL) << "Z3 condition simplification failed: " << e.msg();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (auto w = 0U; w < num_workers; ++w) {
+    auto &ctx = *workers[w].ctx;
+    for (auto i = 0U; i < assigned[w].size(); ++i) {
+      auto z3_result =
+          z3::to_expr(*z3_ctx, Z3_translate(ctx, outputs[w][i], *z3_ctx));
+      SetCond(queries[assigned[w][i]].stmt,
+              z3_gen->GetOrCreateCExpr(z3_result));
+    }
+  }
+  queries.clear();
+}
+
+void Z3CondSimplify::InitPortfolio() {
+  racer_tactics.clear();
+  racer_ctxs.clear();
+  racer_chains.clear();
+  if (FLAGS_z3_portfolio.empty()) {
+    return;
+  }
+  racer_chains.push_back(z3_tactic_names);
+  for (auto &chain : Split(FLAGS_z3_portfolio, ',')) {
+    racer_chains.push_back(Split(chain, '+'));
+  }
+  for (auto i = 0U; i < racer_chains.size(); ++i) {
+    racer_ctxs.emplace_back(new z3::context());
+    try {
+      racer_tactics.push_back(
+          CreateTacticChain(*racer_ctxs.back(), racer_chains[i]));
+    } catch (z3::exception &e) {
+      LOG(FATAL) << "Invalid Z3 tactic chain in portfolio: " << e.msg();
+    }
+  }
+}
+
+// Replaces the context of an interrupted racer, so that no cancellation
+// state carries over to the next race.
+void Z3CondSimplify::ResetRacer(unsigned racer) {
+  std::unique_ptr<z3::context> ctx(new z3::context());
+  // Release the old tactic before its context
+  racer_tactics[racer] = CreateTacticChain(*ctx, racer_chains[racer]);
+  racer_ctxs[racer] = std::move(ctx);
+}
+
+// Runs every racer on `z3_expr` in its own thread and stores the result of
+// the first one that finishes in `z3_result`. The other racers that are
+// still running are interrupted. Returns the index of the winner, or the
+// number of racers if every racer failed.
+unsigned Z3CondSimplify::RaceTactics(z3::expr z3_expr, z3::expr &z3_result) {
+  auto num_racers = racer_tactics.size();
+  std::vector<z3::expr> inputs;
+  std::vector<z3::expr> outputs;
+  // Contexts are not thread-safe, so goals are translated up front
+  for (auto i = 0U; i < num_racers; ++i) {
+    auto &ctx = *racer_ctxs[i];
+    inputs.push_back(z3::to_expr(ctx, Z3_translate(*z3_ctx, z3_expr, ctx)));
+    outputs.push_back(ctx.bool_val(true));
+  }
+
+  std::mutex mutex;
+  auto winner = num_racers;
+  // Racers that are applying their tactics, and racers that were
+  // interrupted while doing so
+  std::vector<bool> running(num_racers, false);
+  std::vector<bool> interrupted(num_racers, false);
+  std::vector<std::thread> threads;
+  for (auto i = 0U; i < num_racers; ++i) {
+    threads.emplace_back([&, i] {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (winner != num_racers) {
+          return;
+        }
+        running[i] = true;
+      }
+      auto done = false;
+      z3::expr output(*racer_ctxs[i]);
+      try {
+        z3::goal goal(*racer_ctxs[i]);
+        goal.add(inputs[i]);
+        auto app = racer_tactics[i](goal);
+        CHECK(app.size() == 1) << "Unexpected multiple goals in application!";
+        output = app[0].as_expr().simplify();
+        done = true;
+      } catch (z3::exception &e) {
+        // Interrupted by the winner, or the chain failed
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      running[i] = false;
+      if (done && winner == num_racers) {
+        winner = i;
+        outputs[i] = output;
+        for (auto j = 0U; j < num_racers; ++j) {
+          if (running[j]) {
+            racer_ctxs[j]->interrupt();
+            interrupted[j] = true;
+          }
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (winner != num_racers) {
+    auto &ctx = *racer_ctxs[winner];
+    z3_result =
+        z3::to_expr(*z3_ctx, Z3_translate(ctx, outputs[winner], *z3_ctx));
+    DLOG(INFO) << "Portfolio race won by racer " << winner;
+  }
+  // Release expressions before their contexts
+  inputs.clear();
+  outputs.clear();
+  for (auto i = 0U; i < num_racers; ++i) {
+    if (interrupted[i]) {
+      ResetRacer(i);
+    }
+  }
+  return winner;
+}
+
+// Simplifies `c_expr` if that does not need Z3. Otherwise returns
+// `nullptr` and sets whether `c_expr` needs the full tactic chain, and an
+// estimate of its cost.
+clang::Expr *Z3CondSimplify::SimplifyWithoutZ3(clang::Expr *c_expr,
+                                               bool &expensive,
+                                               unsigned &weight) {
+  if (FLAGS_native_cond_simplify) {
+    // Z3 is only needed when atoms constrain each other
+    if (auto result = bool_simplifier.Simplify(c_expr)) {
+      return result;
+    }
+  }
+  expensive = true;
+  weight = 1;
+  if (FLAGS_z3_adaptive_tactics) {
+    auto cost = EstimateCost(*ast_ctx, c_expr);
+    if (cost.ops == 0 && cost.nodes <= 3) {
+      // A comparison of two leaves, e.g. `x != 0`
+      return c_expr;
+    }
+    if (cost.atoms <= 2 || cost.nodes > kMaxContextualNodes ||
+        cost.depth > kMaxContextualDepth) {
+      expensive = false;
+    }
+    weight = cost.nodes;
+  }
+  return nullptr;
+}
+
+clang::Expr *Z3CondSimplify::SimplifyCExpr(clang::Stmt *stmt,
+                                           clang::Expr *c_expr) {
+  bool expensive;
+  unsigned weight;
+  if (auto result = SimplifyWithoutZ3(c_expr, expensive, weight)) {
+    return result;
+  }
   auto z3_expr = z3_gen->GetOrCreateZ3Expr(c_expr);
-  z3::goal goal(*z3_ctx);
-  goal.add(z3_expr);
-  // Apply on `z3_simplifier` on condition
-  auto app = z3_simplifier(goal);
-  CHECK(app.size() == 1) << "Unexpected multiple goals in application!";
-  auto z3_result = app[0].as_expr().simplify();
+  auto names = &(expensive ? z3_tactic_names : z3_cheap_tactic_names);
+  Z3QueryTimer timer;
+  z3::expr z3_result(*z3_ctx);
+  auto winner = racer_chains.size();
+  if (expensive && !racer_tactics.empty()) {
+    winner = RaceTactics(z3_expr, z3_result);
+  }
+  if (winner < racer_chains.size()) {
+    names = &racer_chains[winner];
+  } else {
+    z3::goal goal(*z3_ctx);
+    goal.add(z3_expr);
+    // Apply the chosen tactic chain on condition
+    auto &tactic = expensive ? z3_simplifier : z3_cheap_simplifier;
+    auto app = tactic(goal);
+    CHECK(app.size() == 1) << "Unexpected multiple goals in application!";
+    z3_result = app[0].as_expr().simplify();
+  }
+  timer.Finish(z3_expr, Join(*names, "+"), GetState().function, stmt);
   return z3_gen->GetOrCreateCExpr(z3_result);
 }
 
+// Simplifies `cond` of `stmt` now, or queues it for the workers
+void Z3CondSimplify::SimplifyCond(clang::Stmt *stmt, clang::Expr *cond) {
+  if (workers.empty()) {
+    SetCond(stmt, SimplifyCExpr(stmt, cond));
+    return;
+  }
+  bool expensive;
+  unsigned weight;
+  if (auto result = SimplifyWithoutZ3(cond, expensive, weight)) {
+    SetCond(stmt, result);
+    return;
+  }
+  auto z3_expr = z3_gen->GetOrCreateZ3Expr(cond);
+  queries.push_back({stmt, z3_expr, expensive, weight});
+}
+
+bool Z3CondSimplify::VisitFunctionDecl(clang::FunctionDecl *fdecl) {
+  // Conditions of the body have been queued at this point
+  RunQueries();
+  if (z3_gen->FinishFunction()) {
+    ResetZ3Context();
+  }
+  return TransformVisitor<Z3CondSimplify>::VisitFunctionDecl(fdecl);
+}
+
 bool Z3CondSimplify::VisitIfStmt(clang::IfStmt *stmt) {
-  stmt->setCond(SimplifyCExpr(stmt->getCond()));
+  SimplifyCond(stmt, stmt->getCond());
   return true;
 }
 
 bool Z3CondSimplify::VisitWhileStmt(clang::WhileStmt *loop) {
-  loop->setCond(SimplifyCExpr(loop->getCond()));
+  SimplifyCond(loop, loop->getCond());
   return true;
 }
 
 bool Z3CondSimplify::VisitDoStmt(clang::DoStmt *loop) {
-  loop->setCond(SimplifyCExpr(loop->getCond()));
+  SimplifyCond(loop, loop->getCond());
   return true;
 }
 
 bool Z3CondSimplify::runOnModule(llvm::Module &module) {
   LOG(INFO) << "Simplifying conditions using Z3";
   Initialize();
+  InitPortfolio();
+  InitWorkers();
   TraverseDecl(ast_ctx->getTranslationUnitDecl());
   return changed;
 }
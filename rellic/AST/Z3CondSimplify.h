@@ -20,6 +20,11 @@
 
 #include <z3++.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rellic/AST/BoolSimplify.h"
 #include "rellic/AST/IRToASTVisitor.h"
 #include "rellic/AST/TransformVisitor.h"
 #include "rellic/AST/Z3ConvVisitor.h"
@@ -29,14 +34,54 @@ namespace rellic {
 class Z3CondSimplify : public llvm::ModulePass,
                        public TransformVisitor<Z3CondSimplify> {
  private:
-  clang::ASTContext *ast_ctx;
   rellic::IRToASTVisitor *ast_gen;
   std::unique_ptr<z3::context> z3_ctx;
   std::unique_ptr<rellic::Z3ConvVisitor> z3_gen;
+  rellic::BoolSimplifier bool_simplifier;
 
+  // Configured tactic chain, and the chain without its expensive
+  // contextual tactics
   z3::tactic z3_simplifier;
+  z3::tactic z3_cheap_simplifier;
+  std::vector<std::string> z3_tactic_names;
+  std::vector<std::string> z3_cheap_tactic_names;
+
+  // Tactic chains raced on expensive conditions, each in its own context
+  std::vector<std::vector<std::string>> racer_chains;
+  std::vector<std::unique_ptr<z3::context>> racer_ctxs;
+  std::vector<z3::tactic> racer_tactics;
+
+  void InitPortfolio();
+  void ResetRacer(unsigned racer);
+  unsigned RaceTactics(z3::expr z3_expr, z3::expr &z3_result);
+
+  // Simplifies conditions of a function concurrently with the other
+  // workers. Workers own their context, since contexts are not
+  // thread-safe.
+  struct Worker {
+    std::unique_ptr<z3::context> ctx;
+    z3::tactic simplifier;
+    z3::tactic cheap_simplifier;
+  };
+  std::vector<Worker> workers;
 
-  clang::Expr *SimplifyCExpr(clang::Expr *c_expr);
+  // A condition of the current function that is waiting for a worker
+  struct Query {
+    clang::Stmt *stmt;
+    z3::expr z3_expr;
+    bool expensive;
+    unsigned weight;
+  };
+  std::vector<Query> queries;
+
+  void InitWorkers();
+  void ResetZ3Context();
+  void RunQueries();
+
+  clang::Expr *SimplifyWithoutZ3(clang::Expr *c_expr, bool &expensive,
+                                 unsigned &weight);
+  clang::Expr *SimplifyCExpr(clang::Stmt *stmt, clang::Expr *c_expr);
+  void SimplifyCond(clang::Stmt *stmt, clang::Expr *cond);
 
  public:
   static char ID;
@@ -44,9 +89,12 @@ class Z3CondSimplify : public llvm::ModulePass,
   Z3CondSimplify(clang::ASTContext &ctx, rellic::IRToASTVisitor &ast_gen);
 
   z3::context &GetZ3Context() { return *z3_ctx; }
-  
-  void SetZ3Simplifier(z3::tactic tactic) { z3_simplifier = tactic; };
 
+  // Sets the tactic chain used to simplify conditions, e.g.
+  // `{"aig", "ctx-simplify"}`. Throws `z3::exception` on unknown tactics.
+  void SetZ3Tactics(const std::vector<std::string> &tactics);
+
+  bool VisitFunctionDecl(clang::FunctionDecl *fdecl);
   bool VisitIfStmt(clang::IfStmt *stmt);
   bool VisitWhileStmt(clang::WhileStmt *loop);
   bool VisitDoStmt(clang::DoStmt *loop);
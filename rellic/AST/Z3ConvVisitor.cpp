@@ -19,9 +19,16 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <utility>
+#include <vector>
+
 #include "rellic/AST/Util.h"
 #include "rellic/AST/Z3ConvVisitor.h"
 
+DEFINE_uint32(z3_context_functions, 64,
+              "Number of functions after which passes replace their Z3 "
+              "context to bound its memory. 0 keeps contexts alive.");
+
 namespace rellic {
 
 namespace {
@@ -51,6 +58,31 @@ static unsigned GetZ3SortSize(z3::sort sort) {
   }
 }
 
+// Whether `expr` has a C truth value that is best modeled as a Z3 boolean
+static bool IsBooleanExpr(clang::Expr *expr) {
+  if (auto binop = clang::dyn_cast<clang::BinaryOperator>(expr)) {
+    return binop->isComparisonOp() || binop->isLogicalOp();
+  }
+  if (auto unop = clang::dyn_cast<clang::UnaryOperator>(expr)) {
+    return unop->getOpcode() == clang::UO_LNot;
+  }
+  return false;
+}
+
+// Whether `expr` is of floating-point type or has a floating-point operand
+static bool IsFloatingExpr(clang::Expr *expr) {
+  if (expr->getType()->isRealFloatingType()) {
+    return true;
+  }
+  for (auto child : expr->children()) {
+    auto sub = clang::dyn_cast_or_null<clang::Expr>(child);
+    if (sub && sub->getType()->isRealFloatingType()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static std::string CreateZ3DeclName(clang::NamedDecl *decl) {
   std::stringstream ss;
   ss << std::hex << decl << std::dec;
@@ -80,7 +112,11 @@ Z3ConvVisitor::Z3ConvVisitor(clang::ASTContext *c_ctx, z3::context *z3_ctx)
     : ast_ctx(c_ctx),
       z3_ctx(z3_ctx),
       z3_expr_vec(*z3_ctx),
-      z3_decl_vec(*z3_ctx) {}
+      z3_decl_vec(*z3_ctx),
+      abstract_atoms(false),
+      opaque_fp(false),
+      atom_vec(*z3_ctx),
+      num_functions(0) {}
 
 // Inserts a `clang::Expr` <=> `z3::expr` mapping into
 void Z3ConvVisitor::InsertZ3Expr(clang::Expr *c_expr, z3::expr z_expr) {
@@ -172,6 +208,10 @@ z3::sort Z3ConvVisitor::GetZ3Sort(clang::QualType type) {
   auto bitwidth = ast_ctx->getTypeSize(type);
   // Floating points
   if (type->isRealFloatingType()) {
+    if (opaque_fp) {
+      auto name = "Float" + std::to_string(bitwidth);
+      return z3_ctx->uninterpreted_sort(name.c_str());
+    }
     switch (bitwidth) {
       case 16:
         // return z3_ctx.fpa_sort<16>();
@@ -259,6 +299,92 @@ clang::Expr *Z3ConvVisitor::CreateLiteralExpr(z3::expr z_expr) {
   return result;
 }
 
+// Whether `c_expr` is a call, a load, a member access or a pointer cast,
+// which abstraction mode translates to a constant.
+bool Z3ConvVisitor::IsOpaqueExpr(clang::Expr *c_expr) {
+  if (clang::isa<clang::CallExpr>(c_expr) ||
+      clang::isa<clang::MemberExpr>(c_expr) ||
+      clang::isa<clang::ArraySubscriptExpr>(c_expr)) {
+    return true;
+  }
+  if (auto unop = clang::dyn_cast<clang::UnaryOperator>(c_expr)) {
+    return unop->getOpcode() == clang::UO_Deref;
+  }
+  if (auto cast = clang::dyn_cast<clang::CastExpr>(c_expr)) {
+    return cast->getType()->isPointerType() ||
+           cast->getSubExpr()->getType()->isPointerType() ||
+           cast->getSubExpr()->getType()->isArrayType();
+  }
+  return false;
+}
+
+// Retrieves or creates the constant that abstracts `c_expr`.
+z3::expr Z3ConvVisitor::GetOrCreateAtom(clang::Expr *c_expr) {
+  llvm::FoldingSetNodeID key;
+  c_expr->Profile(key, *ast_ctx, /*Canonical=*/true);
+  auto &bucket = atom_ids[key.ComputeHash()];
+  for (auto id : bucket) {
+    if (atom_keys[id] == key) {
+      return atom_vec[id];
+    }
+  }
+  auto z_name = "Atom" + std::to_string(atom_vec.size());
+  auto z_sort = IsBooleanExpr(c_expr) ? z3_ctx->bool_sort()
+                                      : GetZ3Sort(c_expr->getType());
+  auto z_atom = z3_ctx->constant(z_name.c_str(), z_sort);
+  // Atoms translate back to the first expression they abstracted
+  InsertCExpr(z_atom, c_expr);
+  bucket.push_back(atom_vec.size());
+  atom_keys.push_back(key);
+  atom_vec.push_back(z_atom);
+  return z_atom;
+}
+
+// Retrieves or creates the constant that abstracts the floating-point
+// expression `c_expr`. Inequalities are negated equality constants.
+z3::expr Z3ConvVisitor::GetOrCreateFloatingAtom(clang::Expr *c_expr) {
+  auto cmp = clang::dyn_cast<clang::BinaryOperator>(c_expr);
+  if (cmp && cmp->getOpcode() == clang::BO_NE) {
+    auto c_eq = CreateBinaryOperator(*ast_ctx, clang::BO_EQ, cmp->getLHS(),
+                                     cmp->getRHS(), cmp->getType());
+    return !GetOrCreateAtom(c_eq);
+  }
+  return GetOrCreateAtom(c_expr);
+}
+
+// Abstracts opaque expressions without traversing their operands.
+bool Z3ConvVisitor::dataTraverseStmtPre(clang::Stmt *stmt) {
+  auto c_expr = clang::dyn_cast<clang::Expr>(stmt);
+  if (!c_expr) {
+    return true;
+  }
+  if (z3_expr_map.count(c_expr)) {
+    // Already translated, possibly to an atom
+    return false;
+  }
+  if (opaque_fp && IsFloatingExpr(c_expr)) {
+    InsertZ3Expr(c_expr, GetOrCreateFloatingAtom(c_expr));
+    return false;
+  }
+  if (abstract_atoms && IsOpaqueExpr(c_expr)) {
+    InsertZ3Expr(c_expr, GetOrCreateAtom(c_expr));
+    return false;
+  }
+  return true;
+}
+
+bool Z3ConvVisitor::FinishFunction() {
+  z3_expr_vec = z3::expr_vector(*z3_ctx);
+  z3_expr_map.clear();
+  c_expr_map.clear();
+  atom_vec = z3::expr_vector(*z3_ctx);
+  atom_keys.clear();
+  atom_ids.clear();
+  ++num_functions;
+  return FLAGS_z3_context_functions &&
+         num_functions >= FLAGS_z3_context_functions;
+}
+
 // Retrieves or creates`z3::expr`s from `clang::Expr`.
 z3::expr Z3ConvVisitor::GetOrCreateZ3Expr(clang::Expr *c_expr) {
   if (!z3_expr_map.count(c_expr)) {
@@ -282,10 +408,28 @@ z3::func_decl Z3ConvVisitor::GetOrCreateZ3Decl(clang::ValueDecl *c_decl) {
   return z_decl;
 }
 
-// Retrieves or creates `clang::Expr` from `z3::expr`.
+// Retrieves or creates `clang::Expr` from `z3::expr`. Arguments are
+// translated before their applications using an explicit stack, since
+// conditions can be nested thousands of levels deep.
 clang::Expr *Z3ConvVisitor::GetOrCreateCExpr(z3::expr z_expr) {
-  if (!c_expr_map.count(z_expr.hash())) {
-    VisitZ3Expr(z_expr);
+  // Expressions and whether their arguments have been pushed
+  std::vector<std::pair<z3::expr, bool>> work;
+  work.emplace_back(z_expr, false);
+  while (!work.empty()) {
+    auto expr = work.back().first;
+    if (c_expr_map.count(expr.hash())) {
+      work.pop_back();
+    } else if (work.back().second) {
+      work.pop_back();
+      VisitZ3Expr(expr);
+    } else {
+      work.back().second = true;
+      if (expr.is_app()) {
+        for (auto i = expr.num_args(); i > 0; --i) {
+          work.emplace_back(expr.arg(i - 1), false);
+        }
+      }
+    }
   }
   return GetCExpr(z_expr);
 }
@@ -461,29 +605,15 @@ bool Z3ConvVisitor::VisitCallExpr(clang::CallExpr *call) {
   return true;
 }
 
-// Translates clang unary operators expressions to Z3 equivalents.
+// Parentheses only group C syntax, so they translate to their operand.
+// The AST is built without them, and `CEmitter` adds the ones that C
+// precedence requires.
 bool Z3ConvVisitor::VisitParenExpr(clang::ParenExpr *parens) {
   DLOG(INFO) << "VisitParenExpr";
   if (z3_expr_map.count(parens)) {
     return true;
   }
-
-  auto z_sub = GetOrCreateZ3Expr(parens->getSubExpr());
-
-  switch (z_sub.decl().decl_kind()) {
-    // Parens may affect semantics of C expressions
-    case Z3_OP_UNINTERPRETED: {
-      auto sort = z_sub.get_sort();
-      auto z_paren = z3_ctx->function("Paren", sort, sort);
-      InsertZ3Expr(parens, z_paren(z_sub));
-    } break;
-    // Default to ignoring the parens, Z3 should know how
-    // to interpret them.
-    default:
-      InsertZ3Expr(parens, z_sub);
-      break;
-  }
-
+  InsertZ3Expr(parens, GetOrCreateZ3Expr(parens->getSubExpr()));
   return true;
 }
 
@@ -627,11 +757,9 @@ bool Z3ConvVisitor::VisitIntegerLiteral(clang::IntegerLiteral *c_lit) {
   return true;
 }
 
+// Translates `z_expr`, whose arguments have been translated already.
 void Z3ConvVisitor::VisitZ3Expr(z3::expr z_expr) {
   if (z_expr.is_app()) {
-    for (auto i = 0U; i < z_expr.num_args(); ++i) {
-      GetOrCreateCExpr(z_expr.arg(i));
-    }
     switch (z_expr.decl().arity()) {
       case 0:
         VisitConstant(z_expr);
@@ -723,8 +851,6 @@ void Z3ConvVisitor::VisitUnaryApp(z3::expr z_op) {
         CHECK(t_sub->isPointerType()) << "Deref operand type is not a pointer";
         auto t_op = t_sub->getPointeeType();
         c_op = CreateUnaryOperator(*ast_ctx, clang::UO_Deref, c_sub, t_op);
-      } else if (z_func_name == "Paren") {
-        c_op = CreateParenExpr(*ast_ctx, c_sub);
       } else if (z_func_name == "PtrDecay") {
         CHECK(t_sub->isArrayType()) << "PtrDecay operand type is not an array";
         auto t_op = ast_ctx->getArrayDecayedType(t_sub);
@@ -748,6 +874,30 @@ void Z3ConvVisitor::VisitUnaryApp(z3::expr z_op) {
   InsertCExpr(z_op, c_op);
 }
 
+// Combines the arguments of the n-ary `z_op` with `opc` into a tree of
+// logarithmic depth. The operands keep their order, and `NeedsParens` does
+// not parenthesize nested operands of the same `&&` or `||`, so the tree
+// prints the same as a chain.
+clang::Expr *Z3ConvVisitor::CreateBalancedBoolOp(clang::BinaryOperatorKind opc,
+                                                 z3::expr z_op) {
+  std::vector<clang::Expr *> level;
+  for (auto i = 0U; i < z_op.num_args(); ++i) {
+    level.push_back(GetCExpr(z_op.arg(i)));
+  }
+  while (level.size() > 1) {
+    std::vector<clang::Expr *> next;
+    for (auto i = 0U; i + 1 < level.size(); i += 2) {
+      next.push_back(CreateBinaryOperator(*ast_ctx, opc, level[i],
+                                          level[i + 1], ast_ctx->BoolTy));
+    }
+    if (level.size() % 2) {
+      next.push_back(level.back());
+    }
+    level.swap(next);
+  }
+  return level.front();
+}
+
 void Z3ConvVisitor::VisitBinaryApp(z3::expr z_op) {
   DLOG(INFO) << "VisitBinaryApp: " << z_op;
   CHECK(z_op.is_app() && z_op.decl().arity() == 2)
@@ -772,23 +922,13 @@ void Z3ConvVisitor::VisitBinaryApp(z3::expr z_op) {
                                   ast_ctx->BoolTy);
       break;
 
-    case Z3_OP_AND: {
-      c_op = lhs;
-      for (auto i = 1U; i < z_op.num_args(); ++i) {
-        rhs = GetCExpr(z_op.arg(i));
-        c_op = CreateBinaryOperator(*ast_ctx, clang::BO_LAnd, c_op, rhs,
-                                    ast_ctx->BoolTy);
-      }
-    } break;
+    case Z3_OP_AND:
+      c_op = CreateBalancedBoolOp(clang::BO_LAnd, z_op);
+      break;
 
-    case Z3_OP_OR: {
-      c_op = lhs;
-      for (auto i = 1U; i < z_op.num_args(); ++i) {
-        rhs = GetCExpr(z_op.arg(i));
-        c_op = CreateBinaryOperator(*ast_ctx, clang::BO_LOr, c_op, rhs,
-                                    ast_ctx->BoolTy);
-      }
-    } break;
+    case Z3_OP_OR:
+      c_op = CreateBalancedBoolOp(clang::BO_LOr, z_op);
+      break;
 
     case Z3_OP_BADD:
       c_op = CreateBinaryOperator(*ast_ctx, clang::BO_Add, lhs, rhs,
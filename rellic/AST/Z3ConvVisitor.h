@@ -16,11 +16,14 @@
 
 #pragma once
 
+#include <llvm/ADT/FoldingSet.h>
+
 #include <clang/AST/RecursiveASTVisitor.h>
 
 #include <z3++.h>
 
 #include <unordered_map>
+#include <vector>
 
 namespace rellic {
 
@@ -37,6 +40,15 @@ class Z3ConvVisitor : public clang::RecursiveASTVisitor<Z3ConvVisitor> {
   z3::func_decl_vector z3_decl_vec;
   std::unordered_map<clang::ValueDecl *, unsigned> z3_decl_map;
   std::unordered_map<unsigned, clang::ValueDecl *> c_decl_map;
+  // Opaque sub-expressions abstracted to fresh constants. Structurally
+  // equal sub-expressions share a constant.
+  bool abstract_atoms;
+  bool opaque_fp;
+  z3::expr_vector atom_vec;
+  std::vector<llvm::FoldingSetNodeID> atom_keys;
+  std::unordered_map<unsigned, std::vector<unsigned>> atom_ids;
+  // Functions finished since the visitor was created
+  unsigned num_functions;
 
   void InsertZ3Expr(clang::Expr *c_expr, z3::expr z3_expr);
   z3::expr GetZ3Expr(clang::Expr *c_expr);
@@ -52,10 +64,17 @@ class Z3ConvVisitor : public clang::RecursiveASTVisitor<Z3ConvVisitor> {
 
   z3::sort GetZ3Sort(clang::QualType type);
 
+  bool IsOpaqueExpr(clang::Expr *c_expr);
+  z3::expr GetOrCreateAtom(clang::Expr *c_expr);
+  z3::expr GetOrCreateFloatingAtom(clang::Expr *c_expr);
+
   clang::Expr *CreateLiteralExpr(z3::expr z3_expr);
   
   void VisitZ3Expr(z3::expr z3_expr);
 
+  clang::Expr *CreateBalancedBoolOp(clang::BinaryOperatorKind opc,
+                                    z3::expr z3_op);
+
  public:
   z3::func_decl GetOrCreateZ3Decl(clang::ValueDecl *c_decl);
   z3::expr GetOrCreateZ3Expr(clang::Expr *c_expr);
@@ -65,6 +84,27 @@ class Z3ConvVisitor : public clang::RecursiveASTVisitor<Z3ConvVisitor> {
   Z3ConvVisitor(clang::ASTContext *c_ctx, z3::context *z3_ctx);
   bool shouldTraversePostOrder() { return true; }
 
+  // In abstraction mode calls, loads, member accesses and pointer casts
+  // are translated to fresh constants instead of their Z3 semantics, and
+  // translated back to the original expressions. This keeps Z3 from
+  // reasoning about pointers and memory when only the boolean structure of
+  // a condition matters.
+  void SetAbstractAtoms(bool abstract) { abstract_atoms = abstract; }
+
+  // In opaque floating-point mode expressions that compute or consume
+  // floating-point values are translated to fresh constants, so Z3 never
+  // reasons about IEEE semantics. `a != b` is translated as `!(a == b)`,
+  // which holds for floating-point operands as well.
+  void SetOpaqueFloatingPoint(bool opaque) { opaque_fp = opaque; }
+
+  bool dataTraverseStmtPre(clang::Stmt *stmt);
+
+  // Drops the expressions translated for the current function, since other
+  // functions do not share them. Declarations are kept. Returns whether the
+  // owner should replace the Z3 context, which also frees declarations and
+  // internal caches, as configured with `--z3_context_functions`.
+  bool FinishFunction();
+
   z3::expr Z3BoolCast(z3::expr expr);
 
   bool VisitArraySubscriptExpr(clang::ArraySubscriptExpr *sub);
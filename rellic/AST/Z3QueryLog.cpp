@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "rellic/AST/Z3QueryLog.h"
+
+DEFINE_string(z3_query_log, "",
+              "File to which Z3 queries that exceed --z3_slow_query_ms are "
+              "appended.");
+DEFINE_double(z3_slow_query_ms, 1000.0,
+              "Time in milliseconds above which a Z3 query is logged.");
+
+namespace rellic {
+
+namespace {
+
+// Records are delimited by these lines, with one `; key: value` line per
+// field after the begin line and the SMT-LIB2 goal before the end line.
+static const char kBeginRecord[] = "; begin query";
+static const char kEndRecord[] = "; end query";
+
+// Queries may be made from several threads
+static std::mutex log_mutex;
+
+// Returns the position of `stmt` among the statements of its class in a
+// pre-order traversal of the body of `func`, or 0 if it is not found.
+static unsigned GetStmtIndex(clang::FunctionDecl *func, clang::Stmt *stmt) {
+  if (!func->hasBody()) {
+    return 0;
+  }
+  auto index = 0U;
+  std::vector<clang::Stmt *> work{func->getBody()};
+  while (!work.empty()) {
+    auto node = work.back();
+    work.pop_back();
+    if (node->getStmtClass() == stmt->getStmtClass()) {
+      ++index;
+      if (node == stmt) {
+        return index;
+      }
+    }
+    // Reversed, so that children are visited in order
+    std::vector<clang::Stmt *> children;
+    for (auto child : node->children()) {
+      if (child) {
+        children.push_back(child);
+      }
+    }
+    work.insert(work.end(), children.rbegin(), children.rend());
+  }
+  return 0;
+}
+
+// Identifies `stmt` by its class and its index, e.g. `main: IfStmt #3`,
+// which is the same in every run on the same input
+static std::string GetOrigin(clang::FunctionDecl *func, clang::Stmt *stmt) {
+  std::stringstream ss;
+  ss << (func ? func->getNameAsString() : "<unknown>");
+  if (stmt) {
+    ss << ": " << stmt->getStmtClassName();
+    if (auto index = func ? GetStmtIndex(func, stmt) : 0) {
+      ss << " #" << index;
+    }
+  }
+  return ss.str();
+}
+
+static bool StartsWith(const std::string &str, const std::string &prefix) {
+  return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+}  // namespace
+
+Z3QueryTimer::Z3QueryTimer()
+    : enabled(!FLAGS_z3_query_log.empty()),
+      start(std::chrono::steady_clock::now()) {}
+
+void Z3QueryTimer::Finish(z3::expr goal, const std::string &tactics,
+                          clang::FunctionDecl *func, clang::Stmt *stmt) {
+  if (!enabled) {
+    return;
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (elapsed.count() < FLAGS_z3_slow_query_ms) {
+    return;
+  }
+  z3::solver solver(goal.ctx());
+  solver.add(goal);
+  auto smt2 = solver.to_smt2();
+  auto origin = GetOrigin(func, stmt);
+
+  std::lock_guard<std::mutex> lock(log_mutex);
+  std::ofstream os(FLAGS_z3_query_log, std::ios::app);
+  CHECK(os.good()) << "Could not open Z3 query log " << FLAGS_z3_query_log;
+  os << kBeginRecord << '\n'
+     << "; origin: " << origin << '\n'
+     << "; tactics: " << tactics << '\n'
+     << "; time-ms: " << elapsed.count() << '\n'
+     << smt2 << '\n'
+     << kEndRecord << '\n';
+  LOG(WARNING) << "Slow Z3 query (" << elapsed.count() << " ms) in "
+               << origin;
+}
+
+std::vector<Z3Query> ReadZ3QueryLog(const std::string &path) {
+  std::ifstream is(path);
+  CHECK(is.good()) << "Could not open Z3 query log " << path;
+  std::vector<Z3Query> result;
+  Z3Query query;
+  bool in_record = false;
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line == kBeginRecord) {
+      CHECK(!in_record) << "Unterminated query in " << path;
+      query = Z3Query();
+      in_record = true;
+    } else if (line == kEndRecord) {
+      CHECK(in_record) << "Unexpected end of query in " << path;
+      result.push_back(query);
+      in_record = false;
+    } else if (!in_record) {
+      continue;
+    } else if (StartsWith(line, "; origin: ")) {
+      query.origin = line.substr(10);
+    } else if (StartsWith(line, "; tactics: ")) {
+      query.tactics = line.substr(11);
+    } else if (StartsWith(line, "; time-ms: ")) {
+      query.time_ms = std::stod(line.substr(11));
+    } else {
+      query.smt2 += line + '\n';
+    }
+  }
+  CHECK(!in_record) << "Unterminated query in " << path;
+  return result;
+}
+
+}  // namespace rellic
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <clang/AST/Decl.h>
+#include <clang/AST/Stmt.h>
+
+#include <z3++.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace rellic {
+
+// A Z3 query recorded in the slow query log
+struct Z3Query {
+  // Function and statement the query was made for
+  std::string origin;
+  // Tactic chain, e.g. `aig+simplify`
+  std::string tactics;
+  double time_ms = 0;
+  // Goal as SMT-LIB2 assertions
+  std::string smt2;
+};
+
+// Measures a Z3 query. If the query takes longer than
+// `--z3_slow_query_ms`, it is appended to the log file given by
+// `--z3_query_log`, so that it can be replayed with `rellic-z3replay`.
+// Does nothing if there is no log file.
+class Z3QueryTimer {
+ private:
+  bool enabled;
+  std::chrono::steady_clock::time_point start;
+
+ public:
+  Z3QueryTimer();
+
+  // Ends the measurement of the query of `goal` by the tactic chain
+  // `tactics`, made for `stmt` in `func`. Both may be `nullptr`.
+  void Finish(z3::expr goal, const std::string &tactics,
+              clang::FunctionDecl *func, clang::Stmt *stmt);
+};
+
+// Reads the queries of a slow query log
+std::vector<Z3Query> ReadZ3QueryLog(const std::string &path);
+
+}  // namespace rellic
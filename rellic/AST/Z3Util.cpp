@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <glog/logging.h>
+
+#include "rellic/AST/Z3Util.h"
+
+namespace rellic {
+
+z3::tactic CreateTacticChain(z3::context &ctx,
+                             const std::vector<std::string> &names) {
+  CHECK(!names.empty()) << "Empty Z3 tactic chain";
+  z3::tactic tactic(ctx, names.front().c_str());
+  for (auto i = 1U; i < names.size(); ++i) {
+    tactic = tactic & z3::tactic(ctx, names[i].c_str());
+  }
+  return tactic;
+}
+
+}  // namespace rellic
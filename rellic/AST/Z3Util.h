@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <z3++.h>
+
+#include <string>
+#include <vector>
+
+namespace rellic {
+
+// Returns the sequential composition of the Z3 tactics `names`, e.g.
+// `{"aig", "simplify"}`. Throws `z3::exception` on unknown tactics.
+z3::tactic CreateTacticChain(z3::context &ctx,
+                             const std::vector<std::string> &names);
+
+}  // namespace rellic
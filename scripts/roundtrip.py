@@ -49,9 +49,11 @@ def compile(self, clang, input, output, timeout, options=None):
     return p
 
 
-def decompile(self, rellic, input, output, timeout):
+def decompile(self, rellic, input, output, timeout, options=None):
     cmd = []
     cmd.append(rellic)
+    if options is not None:
+        cmd.extend(options)
     cmd.extend(["--input", input, "--output", output])
     p = run_cmd(cmd, timeout)
 
@@ -62,19 +64,33 @@ def decompile(self, rellic, input, output, timeout):
     return p
 
 
+def get_flags(filename, tool):
+    # Tests may give extra flags in `// clang-flags: ...` and
+    # `// rellic-flags: ...` lines
+    prefix = "// %s-flags:" % tool
+    with open(filename) as f:
+        for line in f:
+            if line.startswith(prefix):
+                return line[len(prefix):].split()
+    return []
+
+
 def roundtrip(self, rellic, filename, clang, timeout):
+    flags = get_flags(filename, "clang")
     with tempfile.TemporaryDirectory() as tempdir:
         out1 = os.path.join(tempdir, "out1")
-        compile(self, clang, filename, out1, timeout)
+        compile(self, clang, filename, out1, timeout, flags)
 
         # capture binary run outputs
         cp1 = run_cmd([out1], timeout)
 
         rt_bc = os.path.join(tempdir, "rt.bc")
-        compile(self, clang, filename, rt_bc, timeout, ["-c", "-emit-llvm"])
+        compile(self, clang, filename, rt_bc, timeout,
+                flags + ["-c", "-emit-llvm"])
 
         rt_c = os.path.join(tempdir, "rt.c")
-        decompile(self, rellic, rt_bc, rt_c, timeout)
+        decompile(self, rellic, rt_bc, rt_c, timeout,
+                  get_flags(filename, "rellic"))
 
         out2 = os.path.join(tempdir, "out2")
         compile(self, clang, rt_c, out2, timeout, ["-Wno-everything"])
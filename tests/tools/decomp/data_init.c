@@ -0,0 +1,23 @@
+#include <stdio.h>
+
+int nums[8] = {5, 0, 0, 7, 7, 7};
+double reals[4] = {1.0, 0.0, -2.5};
+char name[16] = "rellic";
+short zeros[4];
+int grid[2][3] = {{1, -2}, {0, 0, 3}};
+
+int main(void)
+{
+    for (int i = 0; i < 8; ++i) {
+        printf("%d ", nums[i]);
+    }
+    for (int i = 0; i < 4; ++i) {
+        printf("%g %d ", reals[i], zeros[i]);
+    }
+    for (int i = 0; i < 6; ++i) {
+        printf("%d ", grid[i / 3][i % 3]);
+    }
+    printf("%s %d\n", name, name[15]);
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+int main(void)
+{
+    unsigned char c = (unsigned char)300;
+    signed char s = -1;
+    unsigned short u = (unsigned short)-2;
+    long long l = (int)(unsigned char)s;
+    unsigned long long m = (unsigned)(short)u;
+    printf("%d %d %u %lld %llu\n", c, s, u, l, m);
+
+    return 0;
+}
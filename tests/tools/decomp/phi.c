@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+int main(void)
+{
+    for (unsigned b = 0; b != 10; ++b) {
+        unsigned c = b % 3 == 0 && b % 2 == 0;
+        unsigned d = b < 3 || b > 7;
+        printf("%u: %u %u %u\n", b, c, d, b % 2 ? c : d);
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+// clang-flags: -O1
+#include <stdio.h>
+
+int main(void)
+{
+    volatile unsigned limit = 5;
+    unsigned i = 0;
+    _Bool more = 1, prev;
+    do {
+        prev = more;
+        more = i < limit;
+        printf("%u: %d\n", i, more);
+        ++i;
+    } while (prev);
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+int main(void)
+{
+    volatile int x = 9, y = 4, z = 2;
+    int a = x, b = y, c = z;
+    printf("%d %d %d\n", a - (b - c), a / (b * c), (a + b) << c);
+    printf("%d %d %d\n", a & (b | c), -(-a), (a ^ b) + c);
+    printf("%d %d\n", !(a && b) || c == 2, (a > b ? a : b) * c);
+    printf("%d\n", a < b ? c : a < c ? b : a);
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+// clang-flags: -O1
+// rellic-flags: --temp_min_uses=2 --temp_min_size=1
+#include <stdio.h>
+
+int main(void)
+{
+    volatile unsigned x = 7, y = 3;
+    unsigned a = x, b = y;
+    unsigned s = a * b + (a ^ b);
+    printf("%u %u %u\n", s, s >> 1, s * s - a);
+
+    return 0;
+}
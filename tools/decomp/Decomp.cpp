@@ -21,19 +21,16 @@
 #include <system_error>
 
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/InitializePasses.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
 
 #include <clang/Basic/TargetInfo.h>
 
-#include "rellic/AST/CondBasedRefine.h"
-#include "rellic/AST/DeadStmtElim.h"
-#include "rellic/AST/ExprCombine.h"
-#include "rellic/AST/GenerateAST.h"
+#include "rellic/AST/CEmitter.h"
 #include "rellic/AST/IRToASTVisitor.h"
-#include "rellic/AST/LoopRefine.h"
-#include "rellic/AST/NestedCondProp.h"
-#include "rellic/AST/NestedScopeCombiner.h"
-#include "rellic/AST/Z3CondSimplify.h"
+#include "rellic/AST/Pipeline.h"
+#include "rellic/AST/Util.h"
 
 #include "rellic/BC/Util.h"
 
@@ -51,6 +48,18 @@
 
 DEFINE_string(input, "", "Input LLVM bitcode file.");
 DEFINE_string(output, "", "Output file.");
+DEFINE_string(pipeline, "default",
+              "Refinement pipeline: a preset (fast, default, thorough) or a "
+              "pipeline description.");
+DEFINE_string(pipeline_file, "",
+              "File containing a refinement pipeline description. Overrides "
+              "--pipeline.");
+DEFINE_string(ir_pipeline, "",
+              "Comma-separated LLVM passes that simplify the input before "
+              "its AST is generated, e.g. simplifycfg,early-cse.");
+DEFINE_uint32(max_fixpoint_iters, 64,
+              "Maximum number of rounds of fixed-point pass groups without an "
+              "explicit cap. 0 means no cap.");
 
 DECLARE_bool(version);
 
@@ -60,12 +69,36 @@ static void InitOptPasses(void) {
   auto& pr = *llvm::PassRegistry::getPassRegistry();
   initializeCore(pr);
   initializeAnalysis(pr);
+  initializeTransformUtils(pr);
+  initializeScalarOpts(pr);
+  initializeInstCombine(pr);
+}
+
+static std::string GetPipelineDesc(void) {
+  if (!FLAGS_pipeline_file.empty()) {
+    auto err_or_buf = llvm::MemoryBuffer::getFile(FLAGS_pipeline_file);
+    if (!err_or_buf) {
+      auto msg = err_or_buf.getError().message();
+      LOG(FATAL) << "Failed to read pipeline file: " << msg;
+    }
+    return err_or_buf.get()->getBuffer();
+  }
+  auto preset = rellic::GetPipelinePreset(FLAGS_pipeline);
+  return preset.empty() ? FLAGS_pipeline : preset;
 }
 
 static bool GeneratePseudocode(llvm::Module& module,
                                llvm::raw_ostream& output) {
   InitOptPasses();
 
+  auto ir_pipeline = rellic::ParseIRPipeline(FLAGS_ir_pipeline);
+  auto pipeline = rellic::ParsePipeline(GetPipelineDesc());
+  for (auto& group : pipeline) {
+    if (group.fixpoint && !group.explicit_cap) {
+      group.max_iters = FLAGS_max_fixpoint_iters;
+    }
+  }
+
   clang::CompilerInstance ins;
   rellic::InitCompilerInstance(ins, module.getTargetTriple());
 
@@ -73,53 +106,10 @@ static bool GeneratePseudocode(llvm::Module& module,
 
   rellic::IRToASTVisitor gen(ast_ctx);
 
-  llvm::legacy::PassManager ast;
-  ast.add(rellic::createGenerateASTPass(ast_ctx, gen));
-  ast.add(rellic::createDeadStmtElimPass(ast_ctx, gen));
-  ast.run(module);
-
-  // Simplifier to use during condition-based refinement
-  auto cbr_simplifier = new rellic::Z3CondSimplify(ast_ctx, gen);
-  cbr_simplifier->SetZ3Simplifier(
-      // Simplify boolean structure with AIGs
-      z3::tactic(cbr_simplifier->GetZ3Context(), "aig") &
-      // Cheap local simplifier
-      z3::tactic(cbr_simplifier->GetZ3Context(), "simplify"));
-
-  llvm::legacy::PassManager cbr;
-  cbr.add(cbr_simplifier);
-  cbr.add(rellic::createNestedCondPropPass(ast_ctx, gen));
-  cbr.add(rellic::createNestedScopeCombinerPass(ast_ctx, gen));
-  cbr.add(rellic::createCondBasedRefinePass(ast_ctx, gen));
-  while (cbr.run(module))
-    ;
-
-  llvm::legacy::PassManager loop;
-  loop.add(rellic::createLoopRefinePass(ast_ctx, gen));
-  loop.add(rellic::createNestedScopeCombinerPass(ast_ctx, gen));
-  while (loop.run(module))
-    ;
-
-  // Simplifier to use during final refinement
-  auto fin_simplifier = new rellic::Z3CondSimplify(ast_ctx, gen);
-  fin_simplifier->SetZ3Simplifier(
-      // Simplify boolean structure with AIGs
-      z3::tactic(fin_simplifier->GetZ3Context(), "aig") &
-      // Propagate bounds over bit-vectors
-      z3::tactic(fin_simplifier->GetZ3Context(), "propagate-bv-bounds") &
-      // Tseitin transformation
-      z3::tactic(fin_simplifier->GetZ3Context(), "tseitin-cnf") &
-      // Contextual simplification
-      z3::tactic(fin_simplifier->GetZ3Context(), "ctx-simplify"));
-
-  llvm::legacy::PassManager fin;
-  fin.add(fin_simplifier);
-  fin.add(rellic::createNestedCondPropPass(ast_ctx, gen));
-  fin.add(rellic::createNestedScopeCombinerPass(ast_ctx, gen));
-  fin.add(rellic::createExprCombinePass(ast_ctx, gen));
-  fin.run(module);
-
-  ast_ctx.getTranslationUnitDecl()->print(output);
+  rellic::RunIRPipeline(ir_pipeline, module);
+  rellic::RunPipeline(pipeline, module, ast_ctx, gen);
+
+  rellic::EmitTranslationUnit(ast_ctx, gen.GetDataInits(), output);
   // ast_ctx.getTranslationUnitDecl()->dump(output);
 
   return true;
@@ -135,6 +125,13 @@ int main(int argc, char* argv[]) {
         << "    --output OUTPUT_C_FILE \\" << std::endl
         << std::endl
 
+        // Refinement pipeline preset or description
+        << "    [--pipeline fast|default|thorough|DESCRIPTION]" << std::endl
+        << "    [--pipeline_file PIPELINE_FILE]" << std::endl
+        << "    [--max_fixpoint_iters N]" << std::endl
+        << "    [--ir_pipeline PASS,PASS,...]" << std::endl
+        << std::endl
+
         // Print the version and exit.
         << "    [--version]" << std::endl
         << std::endl;
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2018 Trail of Bits, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <llvm/Config/llvm-config.h>
+
+#include <z3++.h>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rellic/AST/Util.h"
+#include "rellic/AST/Z3QueryLog.h"
+#include "rellic/AST/Z3Util.h"
+
+#ifndef LLVM_VERSION_STRING
+#define LLVM_VERSION_STRING LLVM_VERSION_MAJOR << "." << LLVM_VERSION_MINOR
+#endif
+
+#ifndef RELLIC_VERSION_STRING
+#define RELLIC_VERSION_STRING "unknown"
+#endif  // RELLIC_VERSION_STRING
+
+#ifndef RELLIC_BRANCH_NAME
+#define RELLIC_BRANCH_NAME "unknown"
+#endif  // RELLIC_BRANCH_NAME
+
+DEFINE_string(input, "", "Z3 query log written with --z3_query_log.");
+DEFINE_string(tactics, "",
+              "Tactic chains to replay the queries with, separated by ','. "
+              "Tactics of a chain are separated by '+'. Defaults to the "
+              "recorded chain of each query.");
+DEFINE_uint32(timeout_ms, 0, "Time limit per tactic application; 0 is none.");
+
+DECLARE_bool(version);
+
+namespace {
+
+static z3::tactic CreateTacticChain(z3::context &ctx, std::string chain) {
+  auto tactic = rellic::CreateTacticChain(ctx, rellic::Split(chain, '+'));
+  if (FLAGS_timeout_ms) {
+    tactic = z3::try_for(tactic, FLAGS_timeout_ms);
+  }
+  return tactic;
+}
+
+// Applies `chain` to `query` in a fresh context and prints the time it took
+static void Replay(const rellic::Z3Query &query, std::string chain) {
+  z3::context ctx;
+  z3::goal goal(ctx);
+  try {
+    auto assertions = ctx.parse_string(query.smt2.c_str());
+    for (auto i = 0U; i < assertions.size(); ++i) {
+      goal.add(assertions[i]);
+    }
+  } catch (z3::exception &e) {
+    std::cout << "  " << chain << ": unparsable query (" << e.msg() << ")"
+              << std::endl;
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::string outcome = "done";
+  try {
+    auto app = CreateTacticChain(ctx, chain)(goal);
+    std::stringstream ss;
+    ss << "done, " << app.size() << " goal(s)";
+    outcome = ss.str();
+  } catch (z3::exception &e) {
+    outcome = e.msg();
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "  " << chain << ": " << elapsed.count() << " ms ("
+            << outcome << ")" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::stringstream usage;
+  usage << std::endl
+        << std::endl
+        << "  " << argv[0] << " \\" << std::endl
+        << "    --input QUERY_LOG \\" << std::endl
+        << "    [--tactics CHAIN,CHAIN,...] \\" << std::endl
+        << "    [--timeout_ms N] \\" << std::endl
+        << std::endl
+
+        // Print the version and exit.
+        << "    [--version]" << std::endl
+        << std::endl;
+
+  std::stringstream version;
+  version << RELLIC_VERSION_STRING << std::endl
+          << "Built from branch: " << RELLIC_BRANCH_NAME << std::endl
+          << "Using LLVM " << LLVM_VERSION_STRING << std::endl;
+
+  google::InitGoogleLogging(argv[0]);
+  google::InstallFailureSignalHandler();
+  google::SetUsageMessage(usage.str());
+  google::SetVersionString(version.str());
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  LOG_IF(ERROR, FLAGS_input.empty())
+      << "Must specify the path to a Z3 query log.";
+
+  if (FLAGS_input.empty()) {
+    std::cerr << google::ProgramUsage();
+    return EXIT_FAILURE;
+  }
+
+  auto queries = rellic::ReadZ3QueryLog(FLAGS_input);
+  auto chains = rellic::Split(FLAGS_tactics, ',');
+  for (auto i = 0U; i < queries.size(); ++i) {
+    auto &query = queries[i];
+    std::cout << "Query " << i << " in " << query.origin << ": "
+              << query.tactics << " took " << query.time_ms << " ms"
+              << std::endl;
+    if (chains.empty()) {
+      Replay(query, query.tactics);
+    }
+    for (auto &chain : chains) {
+      Replay(query, chain);
+    }
+  }
+
+  google::ShutDownCommandLineFlags();
+  google::ShutdownGoogleLogging();
+
+  return EXIT_SUCCESS;
+}